@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "benchmark.hpp"
+#include "command.hpp"
+#include "document.hpp"
+#include "edge.hpp"
+#include "mainwindow.hpp"
+#include "operator.hpp"
+#include "scene.hpp"
+
+#include <QAction>
+#include <QApplication>
+#include <QGraphicsSceneMouseEvent>
+#include <QJsonObject>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+static constexpr int default_sizes[] = { 25, 50, 100, 200, 400 };
+
+// Distance of the operators on the canvas. Large enough that safety rectangles don't overlap.
+static constexpr double spacing_x = 250.0;
+static constexpr double spacing_y = 200.0;
+static constexpr int num_moves = 20;
+
+namespace {
+// Synthetic document: operators placed on a grid and the edges between them.
+struct Layout {
+	struct Op {
+		const char *type;
+		int col, row;
+	};
+	struct Link {
+		size_t op_from, conn_from;
+		size_t op_to, conn_to;
+	};
+	const char *name;
+	std::vector<Op> ops;
+	std::vector<Link> links;
+	size_t hub;	// Operator that is moved around
+};
+}
+
+static int num_columns(int n)
+{
+	return std::max(1, static_cast<int>(ceil(sqrt(n))));
+}
+
+// Chain of conjugate operators, laid out in rows.
+// The edge from the end of one row to the start of the next one crosses the row.
+static Layout make_chain(int n)
+{
+	Layout res { "chain", {}, {}, static_cast<size_t>(n / 2) };
+	int w = num_columns(n);
+	for (int i = 0; i < n; ++i) {
+		res.ops.push_back({ i == 0 ? "const" : "conjugate", i % w, i / w });
+		if (i > 0)
+			res.links.push_back({ static_cast<size_t>(i - 1), 0, static_cast<size_t>(i), 0 });
+	}
+	return res;
+}
+
+// Grid of sum operators, each fed by its left and upper neighbor.
+static Layout make_grid(int n)
+{
+	Layout res { "grid", {}, {}, static_cast<size_t>(n / 2) };
+	int w = num_columns(n);
+	for (int i = 0; i < n; ++i) {
+		int col = i % w, row = i / w;
+		size_t left = i - 1, up = i - w;
+		if (i == 0) {
+			res.ops.push_back({ "const", col, row });
+		} else if (col == 0 || row == 0) {
+			res.ops.push_back({ "conjugate", col, row });
+			res.links.push_back({ col == 0 ? up : left, 0, static_cast<size_t>(i), 0 });
+		} else {
+			res.ops.push_back({ "sum", col, row });
+			res.links.push_back({ left, 0, static_cast<size_t>(i), 0 });
+			res.links.push_back({ up, 0, static_cast<size_t>(i), 1 });
+		}
+	}
+	return res;
+}
+
+// One source feeding all other operators. Moving the source reroutes all edges.
+static Layout make_fan_out(int n)
+{
+	int w = num_columns(n - 1);
+	Layout res { "fan-out", {}, {}, 0 };
+	res.ops.push_back({ "const", 0, (n - 1) / w / 2 });
+	for (int i = 1; i < n; ++i) {
+		res.ops.push_back({ "conjugate", 2 + (i - 1) % w, (i - 1) / w });
+		res.links.push_back({ 0, 0, static_cast<size_t>(i), 0 });
+	}
+	return res;
+}
+
+template <typename Function>
+static double time_ms(Function fun)
+{
+	auto start = std::chrono::steady_clock::now();
+	fun();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void print_header()
+{
+	std::printf("%-8s %5s %5s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+		    "layout", "ops", "edges", "add", "connect", "reroute", "grab", "move", "commit",
+		    "save", "remove", "undo", "redo", "load");
+}
+
+static bool run_layout(MainWindow &w, const Layout &layout)
+{
+	Document &d = w.get_document();
+	Scene &scene = w.get_scene();
+	d.clear(&scene);
+
+	// Add operators one by one, as if placed interactively.
+	std::vector<Operator *> ops;
+	double t_add = time_ms([&]() {
+		for (const Layout::Op &op: layout.ops) {
+			QJsonObject desc {
+				{ "type", QLatin1String(op.type) },
+				{ "x", op.col * spacing_x },
+				{ "y", op.row * spacing_y },
+				{ "state", QJsonObject() }
+			};
+			ops.push_back(Operator::from_json(w, desc));
+		}
+	});
+	if (std::find(ops.begin(), ops.end(), nullptr) != ops.end()) {
+		std::fprintf(stderr, "Couldn't create operators\n");
+		return false;
+	}
+
+	// Connect the operators. Don't calculate: the benchmark measures the canvas.
+	std::vector<Edge *> edges;
+	d.topo.set_suspended(true);
+	double t_connect = time_ms([&]() {
+		for (const Layout::Link &link: layout.links) {
+			auto e = std::make_unique<Edge>(&ops[link.op_from]->get_output_connector(link.conn_from),
+							&ops[link.op_to]->get_input_connector(link.conn_to), d);
+			scene.addItem(&*e);
+			e->recalculate();
+			e->add_connection();
+			edges.push_back(e.release());
+		}
+	});
+	d.topo.set_suspended(false);
+
+	double t_reroute = time_ms([&]() {
+		for (Edge *e: edges)
+			e->recalculate();
+	});
+
+	// Drag the hub back and forth as the scene does it, but without throttling:
+	// The first step removes the operator from the view list (grab), the following
+	// steps only reroute the edges of the hub (average time per step). Releasing
+	// the mouse readds the operator and routes all edges (commit).
+	Operator *hub = ops[layout.hub];
+	QPointF hub_pos = hub->pos();
+	bool moved = true;
+	auto move_step = [&](int i) {
+		if (hub->move_event(hub_pos + QPointF(i % 2 == 0 ? 10.0 : 0.0, 0.0)))
+			hub->reroute_moved_edges();
+		else
+			moved = false;
+	};
+	hub->enter_move_mode(hub_pos);
+	double t_grab = time_ms([&]() { move_step(0); });
+	double t_move = time_ms([&]() {
+		for (int i = 1; i <= num_moves; ++i)
+			move_step(i);
+	}) / num_moves;
+	QGraphicsSceneMouseEvent release(QEvent::GraphicsSceneMouseRelease);
+	release.setButton(Qt::LeftButton);
+	release.setScenePos(hub_pos);
+	double t_commit = time_ms([&]() { QApplication::sendEvent(&scene, &release); });
+	if (!moved) {
+		std::fprintf(stderr, "Couldn't move operator\n");
+		return false;
+	}
+
+	QByteArray data;
+	double t_save = time_ms([&]() { data = d.serialize(&w, &scene, false); });
+
+	// Remove everything and undo / redo the removal
+	std::unique_ptr<QAction> undo(d.undo_action(&w));
+	std::unique_ptr<QAction> redo(d.redo_action(&w));
+	double t_remove = time_ms([&]() {
+		d.place_command<CommandRemoveObjects>(d, scene, ops, std::vector<Edge *>());
+	});
+	double t_undo = time_ms([&]() { undo->trigger(); });
+	double t_redo = time_ms([&]() { redo->trigger(); });
+
+	// Load the saved document. Pass no filename, so that the recent files aren't touched.
+	QTemporaryFile file;
+	if (!file.open() || file.write(data) != data.size() || !file.seek(0)) {
+		std::fprintf(stderr, "Couldn't write temporary file\n");
+		return false;
+	}
+	d.clear(&scene);
+	bool loaded = false;
+	double t_load = time_ms([&]() { loaded = d.load_doit(&w, &scene, file, QString()); });
+	if (!loaded) {
+		std::fprintf(stderr, "Couldn't load saved document\n");
+		return false;
+	}
+	d.clear(&scene);
+
+	std::printf("%-8s %5zu %5zu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+		    layout.name, layout.ops.size(), layout.links.size(),
+		    t_add, t_connect, t_reroute, t_grab, t_move, t_commit, t_save, t_remove, t_undo, t_redo, t_load);
+	std::fflush(stdout);
+	return true;
+}
+
+int run_benchmark(std::vector<int> sizes)
+{
+	if (sizes.empty())
+		sizes.assign(std::begin(default_sizes), std::end(default_sizes));
+
+	MainWindow w(nullptr);
+	w.get_document().change_fft_size(Document::supported_fft_sizes[0], &w.get_scene());
+
+	std::printf("Times in ms (move: per step)\n");
+	print_header();
+	for (int n: sizes) {
+		if (n < 2)
+			continue;
+		for (const Layout &layout: { make_chain(n), make_grid(n), make_fan_out(n) }) {
+			if (!run_layout(w, layout))
+				return 1;
+		}
+	}
+	return 0;
+}
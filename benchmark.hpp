@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+// Canvas benchmark. Builds synthetic documents (chains, grids and fan-outs)
+// through the regular document and scene interfaces and prints the time of
+// the basic canvas operations for growing numbers of operators.
+// Run as "xfft -benchmark [n1 n2 ...]". Use QT_QPA_PLATFORM=offscreen to
+// run it without a display.
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <vector>
+
+// Runs the benchmark for the given numbers of operators (default sizes if empty).
+// Returns the exit code of the program.
+int run_benchmark(std::vector<int> sizes);
+
+#endif
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "binary_document.hpp"
+
+#include <QCborValue>
+#include <QJsonArray>
+#include <QtEndian>
+
+#include <cstring>
+#include <future>
+
+static constexpr char magic[8] = { 'X', 'F', 'F', 'T', 'B', 'I', 'N', '1' };
+static constexpr size_t prefix_size = sizeof(magic) + 2 * sizeof(quint32);
+static constexpr size_t table_entry_size = 3 * sizeof(quint64);
+static constexpr size_t chunk_alignment = 64;
+
+struct Chunk {
+	quint64 offset;
+	quint64 size;
+	quint64 raw_size;
+};
+
+static size_t align(size_t offset)
+{
+	return (offset + chunk_alignment - 1) / chunk_alignment * chunk_alignment;
+}
+
+template <typename T>
+static void write_le(QByteArray &out, size_t offset, T v)
+{
+	qToLittleEndian<T>(v, out.data() + offset);
+}
+
+template <typename T>
+static T read_le(const uchar *data, size_t offset)
+{
+	return qFromLittleEndian<T>(data + offset);
+}
+
+// Replace the value at path by the return value of fun
+template <typename Function>
+static QJsonObject modify_path(QJsonObject obj, const QStringList &path, qsizetype i, Function fun)
+{
+	QJsonValue v = obj[path[i]];
+	if (i + 1 == path.size())
+		obj[path[i]] = fun(v);
+	else if (v.isObject())
+		obj[path[i]] = modify_path(v.toObject(), path, i + 1, fun);
+	return obj;
+}
+
+static bool is_chunk_reference(const QJsonObject &obj)
+{
+	return obj.size() == 1 && obj.contains("chunk");
+}
+
+// Check that all chunk references are valid.
+static bool check_chunks(const QJsonObject &obj, size_t num_chunks)
+{
+	for (const QJsonValue &v: obj) {
+		if (!v.isObject())
+			continue;
+		QJsonObject child = v.toObject();
+		if (is_chunk_reference(child)) {
+			int id = child["chunk"].toInt(-1);
+			if (id < 0 || static_cast<size_t>(id) >= num_chunks)
+				return false;
+		} else if (!check_chunks(child, num_chunks)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::optional<QByteArray> get_chunk(const QJsonValue &v, const std::vector<QByteArray> &chunks)
+{
+	if (!v.isObject() || !is_chunk_reference(v.toObject()))
+		return {};
+	int id = v.toObject()["chunk"].toInt(-1);
+	if (id < 0 || static_cast<size_t>(id) >= chunks.size())
+		return {};
+	return chunks[id];
+}
+
+bool is_binary_document(const uchar *data, size_t size)
+{
+	return size >= sizeof(magic) && memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+QByteArray document_to_binary(const QJsonObject &json, const std::vector<std::vector<QString>> &binary_fields)
+{
+	// Move the binary fields out of the JSON representation.
+	QJsonObject header = json;
+	QJsonArray ops = header["operators"].toArray();
+	std::vector<QByteArray> raw_chunks;
+	for (size_t i = 0; i < binary_fields.size() && i < static_cast<size_t>(ops.size()); ++i) {
+		QJsonObject op = ops[i].toObject();
+		for (const QString &field: binary_fields[i]) {
+			QStringList path = field.split('/');
+			op = modify_path(op, path, 0, [&raw_chunks](const QJsonValue &v) -> QJsonValue {
+				if (!v.isString())
+					return v;
+				QByteArray encoded = v.toString().toLatin1();
+				QByteArray raw = QByteArray::fromBase64(encoded);
+
+				// Only use a chunk if the string is canonical base64. Otherwise conversion would be lossy.
+				if (raw.toBase64() != encoded)
+					return v;
+				raw_chunks.push_back(std::move(raw));
+				return QJsonObject{ { "chunk", static_cast<int>(raw_chunks.size() - 1) } };
+			});
+		}
+		ops[i] = op;
+	}
+	header["operators"] = ops;
+
+	std::vector<std::future<QByteArray>> compressed;
+	compressed.reserve(raw_chunks.size());
+	for (const QByteArray &raw: raw_chunks)
+		compressed.push_back(std::async(std::launch::async, [&raw]() { return qCompress(raw); }));
+
+	QByteArray cbor = QCborValue::fromJsonValue(header).toCbor();
+
+	size_t header_offset = prefix_size + raw_chunks.size() * table_entry_size;
+	QByteArray res(header_offset, '\0');
+	memcpy(res.data(), magic, sizeof(magic));
+	write_le<quint32>(res, sizeof(magic), cbor.size());
+	write_le<quint32>(res, sizeof(magic) + sizeof(quint32), raw_chunks.size());
+	res.append(cbor);
+
+	for (size_t i = 0; i < raw_chunks.size(); ++i) {
+		QByteArray data = compressed[i].get();
+		size_t offset = align(res.size());
+		res.append(QByteArray(offset - res.size(), '\0'));
+		res.append(data);
+
+		size_t entry = prefix_size + i * table_entry_size;
+		write_le<quint64>(res, entry, offset);
+		write_le<quint64>(res, entry + sizeof(quint64), data.size());
+		write_le<quint64>(res, entry + 2 * sizeof(quint64), raw_chunks[i].size());
+	}
+	return res;
+}
+
+std::optional<BinaryDocument> binary_to_document(const uchar *data, size_t size)
+{
+	if (!is_binary_document(data, size) || size < prefix_size)
+		return {};
+	size_t header_size = read_le<quint32>(data, sizeof(magic));
+	size_t num_chunks = read_le<quint32>(data, sizeof(magic) + sizeof(quint32));
+	size_t header_offset = prefix_size + num_chunks * table_entry_size;
+	if (header_offset + header_size > size)
+		return {};
+
+	std::vector<Chunk> chunks(num_chunks);
+	for (size_t i = 0; i < num_chunks; ++i) {
+		size_t entry = prefix_size + i * table_entry_size;
+		Chunk &chunk = chunks[i];
+		chunk.offset = read_le<quint64>(data, entry);
+		chunk.size = read_le<quint64>(data, entry + sizeof(quint64));
+		chunk.raw_size = read_le<quint64>(data, entry + 2 * sizeof(quint64));
+		if (chunk.offset > size || chunk.size > size - chunk.offset)
+			return {};
+	}
+
+	// Uncompress the chunks directly from the (possibly mapped) data,
+	// while the header is parsed.
+	std::vector<std::future<QByteArray>> raw_chunks;
+	raw_chunks.reserve(num_chunks);
+	for (const Chunk &chunk: chunks) {
+		const uchar *chunk_data = data + chunk.offset;
+		qsizetype chunk_size = chunk.size;
+		raw_chunks.push_back(std::async(std::launch::async,
+						[chunk_data, chunk_size]() { return qUncompress(chunk_data, chunk_size); }));
+	}
+
+	QCborParserError error;
+	QByteArray cbor = QByteArray::fromRawData(reinterpret_cast<const char *>(data + header_offset), header_size);
+	QCborValue header = QCborValue::fromCbor(cbor, &error);
+	if (error.error != QCborError::NoError || !header.isMap())
+		return {};
+	BinaryDocument res;
+	res.json = header.toJsonValue().toObject();
+
+	res.chunks.resize(num_chunks);
+	for (size_t i = 0; i < num_chunks; ++i) {
+		res.chunks[i] = raw_chunks[i].get();
+		if (static_cast<size_t>(res.chunks[i].size()) != chunks[i].raw_size)
+			return {};
+	}
+
+	for (const QJsonValue &op: res.json["operators"].toArray()) {
+		if (!check_chunks(op.toObject(), num_chunks))
+			return {};
+	}
+	return res;
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0
+// Binary document format. It contains the same information as the JSON text format,
+// but large binary fields (e.g. images), which are base64 strings in the text format,
+// are stored as separately compressed chunks. This makes files smaller and avoids
+// parsing megabytes of JSON. Conversion between the formats is lossless.
+//
+// Layout (all integers little endian):
+//	magic "XFFTBIN1"
+//	quint32 size of header
+//	quint32 number of chunks
+//	chunk table: per chunk quint64 offset, quint64 compressed size, quint64 uncompressed size
+//	header: the JSON document encoded as CBOR. Binary fields are replaced by { "chunk": id }.
+//	        Only fields of operators are considered.
+//	chunks: zlib compressed (qCompress), each aligned to chunk_alignment bytes.
+
+#ifndef BINARY_DOCUMENT_HPP
+#define BINARY_DOCUMENT_HPP
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+#include <optional>
+#include <vector>
+
+static constexpr const char *binary_document_suffix = "xfftb";
+
+// Returns true if the data starts with the magic of the binary format.
+bool is_binary_document(const uchar *data, size_t size);
+
+// Convert the JSON representation of a document to the binary format.
+// binary_fields contains, for each entry of json["operators"], the paths of the
+// base64 encoded fields, separated by '/' (e.g. "state/data"). Chunks are compressed in parallel.
+QByteArray document_to_binary(const QJsonObject &json, const std::vector<std::vector<QString>> &binary_fields);
+
+// A binary document as loaded: the JSON representation, in which binary
+// fields are still references of the form { "chunk": id }, and the uncompressed
+// chunks. The chunks are passed to the operators as is, see get_chunk().
+struct BinaryDocument {
+	QJsonObject json;
+	std::vector<QByteArray> chunks;
+};
+
+// Convert the binary format to the JSON representation. The data may be a
+// memory mapped file. Chunks are uncompressed in parallel.
+// Returns no value if the data is corrupt.
+std::optional<BinaryDocument> binary_to_document(const uchar *data, size_t size);
+
+// Returns the chunk if v is a chunk reference, otherwise no value.
+// The references were checked when loading.
+std::optional<QByteArray> get_chunk(const QJsonValue &v, const std::vector<QByteArray> &chunks);
+
+#endif
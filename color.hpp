@@ -59,6 +59,15 @@ public:
 	RWLookup();
 };
 
+// Conversion of a hue in the range 0..1 and an intensity, i.e. the value after
+// applying the color mode. Used when the intensity is looked up from a table.
+template <ColorType TYPE>
+uint32_t hue_intensity_to_rgb(double h, double v);
+
+// The same for real values, which are colored according to their sign.
+template <ColorType TYPE>
+uint32_t signed_intensity_to_rgb(bool negative, double v);
+
 template<typename T>
 uint32_t
 (*get_color_lookup_function(ColorType type, ColorMode mode))
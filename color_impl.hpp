@@ -62,88 +62,70 @@ inline double apply_color_mode<ColorMode::LOG>(double v, double factor1, double
 	return v <= std::numeric_limits<double>::epsilon() ? 0.0 : factor2 / (factor2 - log(v * factor1));
 }
 
-template<ColorMode MODE>
-inline uint32_t complex_to_hsv(std::complex<double> c, double factor1, double factor2)
+template <>
+inline uint32_t hue_intensity_to_rgb<ColorType::RW>(double h, double v)
 {
-	double h = (std::arg(c) + std::numbers::pi) / 2.0 / std::numbers::pi;
-	double v = apply_color_mode<MODE>(std::abs(c), factor1, factor2);
-	return hsv_lookup.convert(h, v);
+	return rw_lookup.convert(h, v);
 }
 
-template<ColorMode MODE>
-inline uint32_t real_to_hsv(double v, double factor1, double factor2)
+template <>
+inline uint32_t hue_intensity_to_rgb<ColorType::HSV>(double h, double v)
 {
-	if (v < 0.0) {
-		v = apply_color_mode<MODE>(-v, factor1, factor2);
-		unsigned char vi = static_cast<unsigned char>(v * 255.0);
-		return qRgb(vi, 0, 0);
-	} else {
-		v = apply_color_mode<MODE>(v, factor1, factor2);
-		unsigned char vi = static_cast<unsigned char>(v * 255.0);
-		return qRgb(0, vi, vi);
-	}
+	return hsv_lookup.convert(h, v);
 }
 
-template<ColorMode MODE>
-inline uint32_t complex_to_hsv_white(std::complex<double> c, double factor1, double factor2)
+template <>
+inline uint32_t hue_intensity_to_rgb<ColorType::HSV_WHITE>(double h, double v)
 {
-	double h = (std::arg(c) + std::numbers::pi) / 2.0 / std::numbers::pi;
-	double v = apply_color_mode<MODE>(std::abs(c), factor1, factor2);
 	return hsv_lookup.convert_white(h, v);
 }
 
-template<ColorMode MODE>
-inline uint32_t real_to_hsv_white(double v, double factor1, double factor2)
-{
-	if (v < 0.0) {
-		v = apply_color_mode<MODE>(-v, factor1, factor2);
-		if (v > 1.0)
-			v = 1.0;
-		if (v > 0.5) {
-			v -= 0.5;
-			unsigned char vi = static_cast<unsigned char>(v * 2.0 * 255.0);
-			return qRgb(255, vi, vi);
-		} else {
-			unsigned char vi = static_cast<unsigned char>(v * 2.0 * 255.0);
-			return qRgb(vi, 0, 0);
-		}
-	} else {
-		v = apply_color_mode<MODE>(v, factor1, factor2);
-		if (v > 1.0)
-			v = 1.0;
-		if (v > 0.5) {
-			v -= 0.5;
-			unsigned char vi = static_cast<unsigned char>(v * 2.0 * 255.0);
-			return qRgb(vi, 255, 255);
-		} else {
-			unsigned char vi = static_cast<unsigned char>(v * 2.0 * 255.0);
-			return qRgb(0, vi, vi);
-		}
-	}
+template <>
+inline uint32_t signed_intensity_to_rgb<ColorType::RW>(bool negative, double v)
+{
+	unsigned char vi = static_cast<unsigned char>(v * 255.0);
+	return negative ? qRgb(vi, 0, 0) : qRgb(vi, vi, vi);
 }
 
-template<ColorMode MODE>
-inline uint32_t complex_to_rw(std::complex<double> c, double factor1, double factor2)
+template <>
+inline uint32_t signed_intensity_to_rgb<ColorType::HSV>(bool negative, double v)
 {
-	double h = (std::arg(c) + std::numbers::pi) / 2.0 / std::numbers::pi;
-	double v = apply_color_mode<MODE>(std::abs(c), factor1, factor2);
-	return rw_lookup.convert(h, v);
+	unsigned char vi = static_cast<unsigned char>(v * 255.0);
+	return negative ? qRgb(vi, 0, 0) : qRgb(0, vi, vi);
 }
 
-template<ColorMode MODE>
-inline uint32_t real_to_rw(double v, double factor1, double factor2)
+template <>
+inline uint32_t signed_intensity_to_rgb<ColorType::HSV_WHITE>(bool negative, double v)
 {
-	if (v < 0.0) {
-		v = apply_color_mode<MODE>(-v, factor1, factor2);
-		unsigned char vi = static_cast<unsigned char>(v * 255.0);
-		return qRgb(vi, 0, 0);
+	if (v > 1.0)
+		v = 1.0;
+	if (v > 0.5) {
+		v -= 0.5;
+		unsigned char vi = static_cast<unsigned char>(v * 2.0 * 255.0);
+		return negative ? qRgb(255, vi, vi) : qRgb(vi, 255, 255);
 	} else {
-		v = apply_color_mode<MODE>(v, factor1, factor2);
-		unsigned char vi = static_cast<unsigned char>(v * 255.0);
-		return qRgb(vi, vi, vi);
+		unsigned char vi = static_cast<unsigned char>(v * 2.0 * 255.0);
+		return negative ? qRgb(vi, 0, 0) : qRgb(0, vi, vi);
 	}
 }
 
+inline double complex_to_hue(std::complex<double> c)
+{
+	return (std::arg(c) + std::numbers::pi) / 2.0 / std::numbers::pi;
+}
+
+template<ColorType TYPE, ColorMode MODE>
+inline uint32_t complex_to_rgb(std::complex<double> c, double factor1, double factor2)
+{
+	return hue_intensity_to_rgb<TYPE>(complex_to_hue(c), apply_color_mode<MODE>(std::abs(c), factor1, factor2));
+}
+
+template<ColorType TYPE, ColorMode MODE>
+inline uint32_t real_to_rgb(double v, double factor1, double factor2)
+{
+	return signed_intensity_to_rgb<TYPE>(v < 0.0, apply_color_mode<MODE>(fabs(v), factor1, factor2));
+}
+
 inline unsigned char real_to_grayscale_unchecked(double v)
 {
 	return static_cast<unsigned char>(v * 255.0);
@@ -160,31 +142,31 @@ inline uint32_t
 		switch (mode) {
 			case ColorMode::LINEAR:
 			default:
-				return &complex_to_rw<ColorMode::LINEAR>;
+				return &complex_to_rgb<ColorType::RW, ColorMode::LINEAR>;
 			case ColorMode::ROOT:
-				return &complex_to_rw<ColorMode::ROOT>;
+				return &complex_to_rgb<ColorType::RW, ColorMode::ROOT>;
 			case ColorMode::LOG:
-				return &complex_to_rw<ColorMode::LOG>;
+				return &complex_to_rgb<ColorType::RW, ColorMode::LOG>;
 		}
 	case ColorType::HSV:
 		switch (mode) {
 			case ColorMode::LINEAR:
 			default:
-				return &complex_to_hsv<ColorMode::LINEAR>;
+				return &complex_to_rgb<ColorType::HSV, ColorMode::LINEAR>;
 			case ColorMode::ROOT:
-				return &complex_to_hsv<ColorMode::ROOT>;
+				return &complex_to_rgb<ColorType::HSV, ColorMode::ROOT>;
 			case ColorMode::LOG:
-				return &complex_to_hsv<ColorMode::LOG>;
+				return &complex_to_rgb<ColorType::HSV, ColorMode::LOG>;
 		}
 	case ColorType::HSV_WHITE:
 		switch (mode) {
 			case ColorMode::LINEAR:
 			default:
-				return &complex_to_hsv_white<ColorMode::LINEAR>;
+				return &complex_to_rgb<ColorType::HSV_WHITE, ColorMode::LINEAR>;
 			case ColorMode::ROOT:
-				return &complex_to_hsv_white<ColorMode::ROOT>;
+				return &complex_to_rgb<ColorType::HSV_WHITE, ColorMode::ROOT>;
 			case ColorMode::LOG:
-				return &complex_to_hsv_white<ColorMode::LOG>;
+				return &complex_to_rgb<ColorType::HSV_WHITE, ColorMode::LOG>;
 		}
 	}
 }
@@ -200,31 +182,31 @@ inline uint32_t
 		switch (mode) {
 			case ColorMode::LINEAR:
 			default:
-				return &real_to_rw<ColorMode::LINEAR>;
+				return &real_to_rgb<ColorType::RW, ColorMode::LINEAR>;
 			case ColorMode::ROOT:
-				return &real_to_rw<ColorMode::ROOT>;
+				return &real_to_rgb<ColorType::RW, ColorMode::ROOT>;
 			case ColorMode::LOG:
-				return &real_to_rw<ColorMode::LOG>;
+				return &real_to_rgb<ColorType::RW, ColorMode::LOG>;
 		}
 	case ColorType::HSV:
 		switch (mode) {
 			case ColorMode::LINEAR:
 			default:
-				return &real_to_hsv<ColorMode::LINEAR>;
+				return &real_to_rgb<ColorType::HSV, ColorMode::LINEAR>;
 			case ColorMode::ROOT:
-				return &real_to_hsv<ColorMode::ROOT>;
+				return &real_to_rgb<ColorType::HSV, ColorMode::ROOT>;
 			case ColorMode::LOG:
-				return &real_to_hsv<ColorMode::LOG>;
+				return &real_to_rgb<ColorType::HSV, ColorMode::LOG>;
 		}
 	case ColorType::HSV_WHITE:
 		switch (mode) {
 			case ColorMode::LINEAR:
 			default:
-				return &real_to_hsv_white<ColorMode::LINEAR>;
+				return &real_to_rgb<ColorType::HSV_WHITE, ColorMode::LINEAR>;
 			case ColorMode::ROOT:
-				return &real_to_hsv_white<ColorMode::ROOT>;
+				return &real_to_rgb<ColorType::HSV_WHITE, ColorMode::ROOT>;
 			case ColorMode::LOG:
-				return &real_to_hsv_white<ColorMode::LOG>;
+				return &real_to_rgb<ColorType::HSV_WHITE, ColorMode::LOG>;
 		}
 	}
 }
@@ -6,12 +6,79 @@
 #include "operator.hpp"
 #include "scene.hpp"
 
+#include <QDataStream>
 #include <QMessageBox>
 
+PackableCommand::PackableCommand(UndoStore &store_)
+	: store(store_)
+{
+}
+
+void PackableCommand::unpack()
+{
+	if (!packed)
+		return;
+	std::optional<QByteArray> data = packed->unpack(store);
+	packed.reset();
+	if (!data)
+		QMessageBox::warning(nullptr, "Error", "Couldn't read back undo data. The affected operators are reset.");
+	restore_payload(data ? *data : QByteArray());
+}
+
+size_t PackableCommand::raw_size() const
+{
+	return packed ? packed->get_raw_size() : payload_size();
+}
+
+size_t PackableCommand::memory_usage() const
+{
+	return packed ? packed->memory_usage() : payload_size();
+}
+
+size_t PackableCommand::disk_usage() const
+{
+	return packed ? packed->disk_usage() : 0;
+}
+
+bool PackableCommand::is_packed() const
+{
+	return !!packed;
+}
+
+bool PackableCommand::is_compressing() const
+{
+	return packed && packed->is_compressing();
+}
+
+bool PackableCommand::is_spilled() const
+{
+	return packed && packed->is_spilled();
+}
+
+void PackableCommand::pack()
+{
+	if (packed || payload_size() == 0)
+		return;
+	packed = std::make_unique<PackedData>(take_payload());
+}
+
+void PackableCommand::poll()
+{
+	if (packed)
+		packed->poll();
+}
+
+void PackableCommand::spill()
+{
+	if (packed)
+		packed->spill(store);
+}
+
 CommandPlace::CommandPlace(Document &document_, Scene &scene_, std::unique_ptr<Operator> op_,
 			   std::vector<std::pair<Connector *, Connector *>> edges_to_add_,
 			   std::vector<std::pair<Connector *, Connector *>> edges_to_remove_)
-	: document(document_)
+	: PackableCommand(document_.get_undo_store())
+	, document(document_)
 	, scene(scene_)
 	, op_to_add(std::move(op_))
 	, edges_to_add(std::move(edges_to_add_))
@@ -72,9 +139,28 @@ static std::unique_ptr<Operator> remove_operator(Operator *&op)
 	return std::unique_ptr<Operator>(std::exchange(op, nullptr));
 }
 
+size_t CommandPlace::payload_size() const
+{
+	return op_to_add ? op_to_add->undo_payload_size() : 0;
+}
+
+QByteArray CommandPlace::take_payload()
+{
+	return op_to_add ? op_to_add->take_undo_payload() : QByteArray();
+}
+
+void CommandPlace::restore_payload(const QByteArray &data)
+{
+	if (op_to_add)
+		payload_lost = !op_to_add->restore_undo_payload(data);
+}
+
 void CommandPlace::redo()
 {
+	unpack();
 	op_to_remove = add_operator(op_to_add);
+	if (std::exchange(payload_lost, false))
+		op_to_remove->state_reset();
 
 	// Note: it is crucial to remove edges before adding edges, because adding edges may induce edge removal.
 	remove_edges(edges_to_remove);
@@ -118,7 +204,8 @@ void CommandPlaceEdge::undo()
 CommandRemoveObjects::CommandRemoveObjects(Document &document_, Scene &scene_,
 					   std::vector<Operator *> ops_to_remove_,
 					   std::vector<Edge *> edges_to_remove)
-	: document(document_)
+	: PackableCommand(document_.get_undo_store())
+	, document(document_)
 	, scene(scene_)
 	, ops_to_remove(ops_to_remove_)
 {
@@ -143,6 +230,34 @@ CommandRemoveObjects::CommandRemoveObjects(Document &document_, Scene &scene_,
 		edges_to_add_or_remove.emplace_back(e->get_connector_from(), e->get_connector_to());
 }
 
+size_t CommandRemoveObjects::payload_size() const
+{
+	size_t res = 0;
+	for (auto &op: ops_to_add)
+		res += op->undo_payload_size();
+	return res;
+}
+
+QByteArray CommandRemoveObjects::take_payload()
+{
+	QByteArray res;
+	QDataStream stream(&res, QIODevice::WriteOnly);
+	for (auto &op: ops_to_add)
+		stream << op->take_undo_payload();
+	return res;
+}
+
+void CommandRemoveObjects::restore_payload(const QByteArray &data)
+{
+	QDataStream stream(data);
+	for (auto &op: ops_to_add) {
+		QByteArray op_data;
+		stream >> op_data;
+		if (!op->restore_undo_payload(op_data))
+			payload_lost = true;
+	}
+}
+
 void CommandRemoveObjects::redo()
 {
 	remove_edges(edges_to_add_or_remove);
@@ -154,9 +269,14 @@ void CommandRemoveObjects::redo()
 
 void CommandRemoveObjects::undo()
 {
+	unpack();
 	for (auto &op: ops_to_add)
 		ops_to_remove.push_back(add_operator(op));
 	ops_to_add.clear();
+	if (std::exchange(payload_lost, false)) {
+		for (Operator *op: ops_to_remove)
+			op->state_reset();
+	}
 	place_edges(edges_to_add_or_remove, document, scene);
 }
 
@@ -164,7 +284,8 @@ CommandSetState::CommandSetState(Document &document_, Scene &scene_,
 				 const QString &text, Operator *op_,
 				 std::unique_ptr<Operator::State> state_,
 				 bool merge_)
-	: document(document_)
+	: PackableCommand(document_.get_undo_store())
+	, document(document_)
 	, scene(scene_)
 	, op(op_)
 	, merge(merge_)
@@ -173,8 +294,24 @@ CommandSetState::CommandSetState(Document &document_, Scene &scene_,
 	setText(text);
 }
 
+size_t CommandSetState::payload_size() const
+{
+	return state->payload_size();
+}
+
+QByteArray CommandSetState::take_payload()
+{
+	return state->take_payload();
+}
+
+void CommandSetState::restore_payload(const QByteArray &data)
+{
+	state->restore_payload(data);
+}
+
 void CommandSetState::redo()
 {
+	unpack();
 	op->swap_state(*state);
 	op->state_reset();
 }
@@ -199,6 +336,70 @@ bool CommandSetState::mergeWith(const QUndoCommand *cmd_)
 	return cmd && cmd->op == op && cmd->merge;
 }
 
+CommandDrawImage::CommandDrawImage(Document &document_, Scene &scene_,
+				   const QString &text, Operator *op_,
+				   ImageDelta delta_, bool merge_)
+	: PackableCommand(document_.get_undo_store())
+	, document(document_)
+	, scene(scene_)
+	, op(op_)
+	, merge(merge_)
+	, drawn(true)
+	, delta(std::move(delta_))
+{
+	setText(text);
+}
+
+size_t CommandDrawImage::payload_size() const
+{
+	return delta.memory_usage();
+}
+
+QByteArray CommandDrawImage::take_payload()
+{
+	return delta.take_data();
+}
+
+void CommandDrawImage::restore_payload(const QByteArray &data)
+{
+	delta.restore_data(data);
+}
+
+void CommandDrawImage::redo()
+{
+	// When the command is placed, the drawing has already been done.
+	if (drawn) {
+		drawn = false;
+		return;
+	}
+	unpack();
+	op->swap_image_delta(delta);
+}
+
+void CommandDrawImage::undo()
+{
+	unpack();
+	op->swap_image_delta(delta);
+}
+
+int CommandDrawImage::id() const
+{
+	return 4712;
+}
+
+bool CommandDrawImage::mergeWith(const QUndoCommand *cmd_)
+{
+	// The operator already contains the drawing of the new command.
+	// Keep our tiles, since they represent the older state, and add
+	// the tiles that were painted on for the first time.
+	const CommandDrawImage *cmd = dynamic_cast<const CommandDrawImage *>(cmd_);
+	if (!cmd || cmd->op != op || !cmd->merge)
+		return false;
+	unpack();
+	delta.merge(cmd->delta);
+	return true;
+}
+
 CommandMove::CommandMove(Document &document_, Scene &scene_,
 			 Operator *op_, QPointF old_pos_, QPointF new_pos_)
 	: document(document_)
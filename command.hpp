@@ -5,6 +5,8 @@
 #define COMMAND_HPP
 
 #include "operator.hpp" // for Operator::State
+#include "image_delta.hpp"
+#include "undo_store.hpp"
 
 #include <vector>
 #include <memory>
@@ -15,13 +17,40 @@ class Document;
 class Scene;
 class Connector;
 
+// Commands that keep heavy data alive (images, removed operators).
+// To bound the memory use of the undo stack, the document packs the
+// data of old commands, see UndoStore. Subclasses must call unpack()
+// before accessing the data in undo(), redo() and mergeWith().
+class PackableCommand : public QUndoCommand {
+	UndoStore &store;
+	std::unique_ptr<PackedData> packed;
+
+	virtual size_t payload_size() const = 0;
+	virtual QByteArray take_payload() = 0;
+	virtual void restore_payload(const QByteArray &) = 0;
+protected:
+	PackableCommand(UndoStore &store);
+	void unpack();
+public:
+	size_t raw_size() const;	// Size of data if it were unpacked
+	size_t memory_usage() const;
+	size_t disk_usage() const;
+	bool is_packed() const;
+	bool is_compressing() const;	// Packed, but compressed data not yet collected
+	bool is_spilled() const;
+	void pack();		// Compress in background
+	void poll();		// Collect compressed data, if compression finished
+	void spill();		// Write to disk, if compression finished
+};
+
 // Place an operator
-class CommandPlace : public QUndoCommand {
+class CommandPlace : public PackableCommand {
 	Document &document;
 	Scene &scene;
 
 	// For redo():
 	std::unique_ptr<Operator> op_to_add;
+	bool payload_lost = false;	// Operator must be reset after adding
 
 	// For undo():
 	Operator *op_to_remove;
@@ -30,6 +59,9 @@ class CommandPlace : public QUndoCommand {
 	std::vector<std::pair<Connector *, Connector *>> edges_to_add;
 	std::vector<std::pair<Connector *, Connector *>> edges_to_remove;
 
+	size_t payload_size() const override final;
+	QByteArray take_payload() override final;
+	void restore_payload(const QByteArray &) override final;
 	void undo() override final;
 	void redo() override final;
 public:
@@ -58,7 +90,7 @@ public:
 };
 
 // Remove objects
-class CommandRemoveObjects : public QUndoCommand {
+class CommandRemoveObjects : public PackableCommand {
 	Document &document;
 	Scene &scene;
 
@@ -67,10 +99,14 @@ class CommandRemoveObjects : public QUndoCommand {
 
 	// For undo():
 	std::vector<std::unique_ptr<Operator>> ops_to_add;
+	bool payload_lost = false;	// Operators must be reset after adding
 
 	// For undo() and redo():
 	std::vector<std::pair<Connector *, Connector *>> edges_to_add_or_remove;
 
+	size_t payload_size() const override final;
+	QByteArray take_payload() override final;
+	void restore_payload(const QByteArray &) override final;
 	void undo() override final;
 	void redo() override final;
 public:
@@ -79,7 +115,7 @@ public:
 			     std::vector<Edge *> edges_to_remove);
 };
 
-class CommandSetState : public QUndoCommand {
+class CommandSetState : public PackableCommand {
 	Document &document;
 	Scene &scene;
 
@@ -89,6 +125,9 @@ class CommandSetState : public QUndoCommand {
 	// For undo() and redo():
 	std::unique_ptr<Operator::State> state;
 
+	size_t payload_size() const override final;
+	QByteArray take_payload() override final;
+	void restore_payload(const QByteArray &) override final;
 	int id() const override final; // We have to implement this so that Qt tries to merge commands. Sigh.
 	void undo() override final;
 	void redo() override final;
@@ -100,6 +139,32 @@ public:
 			bool merge);
 };
 
+// Drawing on an image. Instead of the whole state, only the changed tiles are stored.
+// The operator has already drawn when the command is placed.
+class CommandDrawImage : public PackableCommand {
+	Document &document;
+	Scene &scene;
+
+	Operator *op;
+	bool merge;
+	bool drawn;
+
+	// For undo() and redo():
+	ImageDelta delta;
+
+	size_t payload_size() const override final;
+	QByteArray take_payload() override final;
+	void restore_payload(const QByteArray &) override final;
+	int id() const override final;
+	void undo() override final;
+	void redo() override final;
+	bool mergeWith(const QUndoCommand *) override final;
+public:
+	CommandDrawImage(Document &document, Scene &scene,
+			 const QString &text, Operator *op,
+			 ImageDelta delta, bool merge);
+};
+
 class CommandMove : public QUndoCommand {
 	Document &document;
 	Scene &scene;
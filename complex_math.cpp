@@ -0,0 +1,566 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "complex_math.hpp"
+#include "aligned_buf.hpp"	// For assume_aligned
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Compile the fast paths for AVX2 and the baseline instruction set.
+// The dynamic linker chooses the variant when the program is loaded.
+#if defined(__x86_64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#define MULTIVERSION __attribute__((target_clones("avx2", "default")))
+#else
+#define MULTIVERSION
+#endif
+
+// The polynomial approximations are taken from the Cephes math library.
+// All branches are replaced by selects, so that loops can be vectorized.
+
+// Arcus tangent for 0 <= t <= 1
+static inline double fast_atan_unit(double t)
+{
+	constexpr double p0 = -8.750608600031904122785e-1;
+	constexpr double p1 = -1.615753718733365076637e1;
+	constexpr double p2 = -7.500855792314704667340e1;
+	constexpr double p3 = -1.228866684490136173410e2;
+	constexpr double p4 = -6.485021904942025371773e1;
+	constexpr double q0 = 2.485846490142306297962e1;
+	constexpr double q1 = 1.650270098316988542046e2;
+	constexpr double q2 = 4.328810604912902668951e2;
+	constexpr double q3 = 4.853903996359136964868e2;
+	constexpr double q4 = 1.945506571482613964425e2;
+	constexpr double morebits = 6.123233995736765886130e-17;	// Rounding error of pi/2
+
+	// For t > 0.66 use atan(t) = pi/4 + atan((t - 1) / (t + 1))
+	bool big = t > 0.66;
+	double x = big ? (t - 1.0) / (t + 1.0) : t;
+	double offset = big ? M_PI_4 : 0.0;
+	double correction = big ? 0.5 * morebits : 0.0;
+
+	double z = x * x;
+	double p = (((p0 * z + p1) * z + p2) * z + p3) * z + p4;
+	double q = ((((z + q0) * z + q1) * z + q2) * z + q3) * z + q4;
+	return offset + (x * z * p / q + x + correction);
+}
+
+static inline double fast_atan2(double y, double x)
+{
+	double ax = std::abs(x);
+	double ay = std::abs(y);
+	double max = std::max(ax, ay);
+	double min = std::min(ax, ay);
+	double t = max > 0.0 ? min / max : 0.0;
+
+	double a = fast_atan_unit(t);
+	a = ay > ax ? M_PI_2 - a : a;
+	a = x < 0.0 ? M_PI - a : a;
+	return std::copysign(a, y);
+}
+
+static inline void fast_sincos(double x, double &s, double &c)
+{
+	// pi/2 split into three parts for exact range reduction
+	constexpr double dp1 = 1.57079625129699707031e0;
+	constexpr double dp2 = 7.54978941586159635335e-8;
+	constexpr double dp3 = 5.39030285815811905290e-15;
+	constexpr double s0 = 1.58962301576546568060e-10;
+	constexpr double s1 = -2.50507477628578072866e-8;
+	constexpr double s2 = 2.75573136213857245213e-6;
+	constexpr double s3 = -1.98412698295895385996e-4;
+	constexpr double s4 = 8.33333333332211858878e-3;
+	constexpr double s5 = -1.66666666666666307295e-1;
+	constexpr double c0 = -1.13585365213876817300e-11;
+	constexpr double c1 = 2.08757008419747316778e-9;
+	constexpr double c2 = -2.75573141792967388112e-7;
+	constexpr double c3 = 2.48015872888517045348e-5;
+	constexpr double c4 = -1.38888888888730564116e-3;
+	constexpr double c5 = 4.16666666666665929218e-2;
+
+	// Reduce to -pi/4 <= r <= pi/4 and the quadrant 0 <= quadrant < 4
+	double q = std::nearbyint(x * M_2_PI);
+	double r = ((x - q * dp1) - q * dp2) - q * dp3;
+	double quadrant = q - 4.0 * std::floor(q * 0.25);
+
+	double zz = r * r;
+	double sin_r = r + r * zz * (((((s0 * zz + s1) * zz + s2) * zz + s3) * zz + s4) * zz + s5);
+	double cos_r = 1.0 - 0.5 * zz + zz * zz * (((((c0 * zz + c1) * zz + c2) * zz + c3) * zz + c4) * zz + c5);
+
+	bool swap = quadrant == 1.0 || quadrant == 3.0;
+	double sin_q = swap ? cos_r : sin_r;
+	double cos_q = swap ? sin_r : cos_r;
+	s = quadrant >= 2.0 ? -sin_q : sin_q;
+	c = quadrant == 1.0 || quadrant == 2.0 ? -cos_q : cos_q;
+}
+
+// Exponential function. Range reduction to |r| <= ln(2)/2 and a rational
+// approximation. The scaling by 2^k is split into two factors, so that
+// both fit into the exponent of a normal number.
+static inline double fast_exp(double x)
+{
+	constexpr double p0 = 1.26177193074810590878e-4;
+	constexpr double p1 = 3.02994407707441961300e-2;
+	constexpr double p2 = 9.99999999999999999910e-1;
+	constexpr double q0 = 3.00198505138664455042e-6;
+	constexpr double q1 = 2.52448340349684104192e-3;
+	constexpr double q2 = 2.27265548208155028766e-1;
+	constexpr double q3 = 2.00000000000000000009e0;
+	constexpr double c1 = 6.93145751953125e-1;		// ln(2) split into two parts
+	constexpr double c2 = 1.42860682030941723212e-6;
+	constexpr double max_log = 7.09782712893383996843e2;
+	constexpr double min_log = -7.08396418532264106224e2;
+
+	// NaNs are replaced, so that the conversion to integer is defined
+	double xc = x > max_log ? max_log : x < min_log ? min_log : x == x ? x : 0.0;
+	double k = std::nearbyint(xc * M_LOG2E);
+	double r = (xc - k * c1) - k * c2;
+
+	double rr = r * r;
+	double p = r * ((p0 * rr + p1) * rr + p2);
+	double q = ((q0 * rr + q1) * rr + q2) * rr + q3;
+	double e = 1.0 + 2.0 * p / (q - p);
+
+	int64_t k1 = static_cast<int64_t>(k) / 2;
+	int64_t k2 = static_cast<int64_t>(k) - k1;
+	double scale1 = std::bit_cast<double>(static_cast<uint64_t>(k1 + 1023) << 52);
+	double scale2 = std::bit_cast<double>(static_cast<uint64_t>(k2 + 1023) << 52);
+	double res = e * scale1 * scale2;
+
+	res = x > max_log ? HUGE_VAL : res;
+	res = x < min_log ? 0.0 : res;
+	return x == x ? res : x;
+}
+
+// Natural logarithm. The argument is split into 2^e * m with sqrt(1/2) <= m < sqrt(2)
+// and log(m) is calculated by a rational approximation.
+static inline double fast_log(double x)
+{
+	constexpr double p0 = 1.01875663804580931796e-4;
+	constexpr double p1 = 4.97494994976747001425e-1;
+	constexpr double p2 = 4.70579119878881725854e0;
+	constexpr double p3 = 1.44989225341610930846e1;
+	constexpr double p4 = 1.79368678507819816313e1;
+	constexpr double p5 = 7.70838733755885391666e0;
+	constexpr double q0 = 1.12873587189167450590e1;
+	constexpr double q1 = 4.52279145837532221105e1;
+	constexpr double q2 = 8.29875266912776603211e1;
+	constexpr double q3 = 7.11544750618563894466e1;
+	constexpr double q4 = 2.31251620126765340583e1;
+	constexpr double c1 = 0.693359375;			// ln(2) split into two parts
+	constexpr double c2 = -2.121944400546905827679e-4;
+	constexpr double min_normal = std::numeric_limits<double>::min();
+
+	// Scale subnormal numbers into the normal range
+	bool subnormal = x < min_normal;
+	double xs = subnormal ? x * 0x1p54 : x;
+	uint64_t bits = std::bit_cast<uint64_t>(xs);
+	double e = static_cast<double>(static_cast<int64_t>((bits >> 52) & 0x7ff) - 1022) - (subnormal ? 54.0 : 0.0);
+	double m = std::bit_cast<double>((bits & 0x000fffffffffffffULL) | 0x3fe0000000000000ULL);	// [0.5, 1)
+
+	bool small = m < M_SQRT1_2;
+	e = small ? e - 1.0 : e;
+	double t = small ? 2.0 * m - 1.0 : m - 1.0;
+
+	double z = t * t;
+	double p = ((((p0 * t + p1) * t + p2) * t + p3) * t + p4) * t + p5;
+	double q = ((((t + q0) * t + q1) * t + q2) * t + q3) * t + q4;
+	double y = t * (z * p / q) + e * c2 - 0.5 * z;
+	double res = t + y + e * c1;
+
+	res = x == HUGE_VAL ? x : res;
+	return x > 0.0 ? res : x == 0.0 ? -HUGE_VAL : std::numeric_limits<double>::quiet_NaN();
+}
+
+// Access complex data as interleaved doubles. This is explicitly allowed for std::complex.
+static inline const double *as_doubles(const std::complex<double> *c)
+{
+	return reinterpret_cast<const double *>(assume_aligned(c));
+}
+
+static inline double *as_doubles(std::complex<double> *c)
+{
+	return reinterpret_cast<double *>(assume_aligned(c));
+}
+
+static inline double amplitude(const double *in, size_t i)
+{
+	return in[i];
+}
+
+static inline double amplitude(const std::complex<double> *in, size_t i)
+{
+	const double *d = as_doubles(in);
+	return std::sqrt(d[2*i] * d[2*i] + d[2*i + 1] * d[2*i + 1]);
+}
+
+MULTIVERSION
+static void abs_data_fast(size_t n, const std::complex<double> *in, double *out)
+{
+	out = assume_aligned(out);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = amplitude(in, i);
+}
+
+void abs_data(size_t n, const std::complex<double> *in, double *out, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		return abs_data_fast(n, in, out);
+	for (size_t i = 0; i < n; ++i)
+		*out++ = std::abs(*in++);
+}
+
+MULTIVERSION
+static void abs_arg_data_fast(size_t n, const std::complex<double> *in, double *abs_out, double *arg_out,
+			      double arg_factor)
+{
+	const double *d = as_doubles(in);
+	abs_out = assume_aligned(abs_out);
+	arg_out = assume_aligned(arg_out);
+	for (size_t i = 0; i < n; ++i) {
+		double re = d[2*i];
+		double im = d[2*i + 1];
+		abs_out[i] = std::sqrt(re * re + im * im);
+		arg_out[i] = fast_atan2(im, re) * arg_factor;
+	}
+}
+
+void abs_arg_data(size_t n, const std::complex<double> *in, double *abs_out, double *arg_out,
+		  double arg_factor, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		return abs_arg_data_fast(n, in, abs_out, arg_out, arg_factor);
+	for (size_t i = 0; i < n; ++i) {
+		std::complex<double> c = *in++;
+		*abs_out++ = std::abs(c);
+		*arg_out++ = std::arg(c) * arg_factor;
+	}
+}
+
+template <typename T>
+static inline void polar_data_fast(size_t n, const T *amplitudes, const double *phases, double phase_factor,
+				   std::complex<double> *out)
+{
+	double *d = as_doubles(out);
+	phases = assume_aligned(phases);
+	for (size_t i = 0; i < n; ++i) {
+		double amp = amplitude(amplitudes, i);
+		double s, c;
+		fast_sincos(phases[i] * phase_factor, s, c);
+		d[2*i] = amp * c;
+		d[2*i + 1] = amp * s;
+	}
+}
+
+template <typename T>
+static inline void polar_data_fast(size_t n, const T *amplitudes, const std::complex<double> *phases,
+				   std::complex<double> *out)
+{
+	const double *p = as_doubles(phases);
+	double *d = as_doubles(out);
+	for (size_t i = 0; i < n; ++i) {
+		double amp = amplitude(amplitudes, i);
+		double re = p[2*i];
+		double im = p[2*i + 1];
+		double norm = re * re + im * im;
+		// A phase of zero is taken to be real (arg(0) = 0).
+		double factor = norm > 0.0 ? amp / std::sqrt(norm) : 0.0;
+		d[2*i] = norm > 0.0 ? re * factor : amp;
+		d[2*i + 1] = im * factor;
+	}
+}
+
+static inline double precise_amplitude(double v)
+{
+	return v;
+}
+
+static inline double precise_amplitude(std::complex<double> v)
+{
+	return std::abs(v);
+}
+
+template <typename T>
+static void polar_data_precise(size_t n, const T *amplitudes, const double *phases, double phase_factor,
+			       std::complex<double> *out)
+{
+	for (size_t i = 0; i < n; ++i)
+		*out++ = std::polar(precise_amplitude(*amplitudes++), *phases++ * phase_factor);
+}
+
+template <typename T>
+static void polar_data_precise(size_t n, const T *amplitudes, const std::complex<double> *phases,
+			       std::complex<double> *out)
+{
+	for (size_t i = 0; i < n; ++i)
+		*out++ = std::polar(precise_amplitude(*amplitudes++), std::arg(*phases++));
+}
+
+MULTIVERSION
+static void polar_data_fast_rr(size_t n, const double *amplitudes, const double *phases, double phase_factor,
+			       std::complex<double> *out)
+{
+	polar_data_fast(n, assume_aligned(amplitudes), phases, phase_factor, out);
+}
+
+MULTIVERSION
+static void polar_data_fast_cr(size_t n, const std::complex<double> *amplitudes, const double *phases, double phase_factor,
+			       std::complex<double> *out)
+{
+	polar_data_fast(n, amplitudes, phases, phase_factor, out);
+}
+
+MULTIVERSION
+static void polar_data_fast_rc(size_t n, const double *amplitudes, const std::complex<double> *phases,
+			       std::complex<double> *out)
+{
+	polar_data_fast(n, assume_aligned(amplitudes), phases, out);
+}
+
+MULTIVERSION
+static void polar_data_fast_cc(size_t n, const std::complex<double> *amplitudes, const std::complex<double> *phases,
+			       std::complex<double> *out)
+{
+	polar_data_fast(n, amplitudes, phases, out);
+}
+
+void polar_data(size_t n, const double *amplitudes, const double *phases, double phase_factor,
+		std::complex<double> *out, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		polar_data_fast_rr(n, amplitudes, phases, phase_factor, out);
+	else
+		polar_data_precise(n, amplitudes, phases, phase_factor, out);
+}
+
+void polar_data(size_t n, const std::complex<double> *amplitudes, const double *phases, double phase_factor,
+		std::complex<double> *out, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		polar_data_fast_cr(n, amplitudes, phases, phase_factor, out);
+	else
+		polar_data_precise(n, amplitudes, phases, phase_factor, out);
+}
+
+void polar_data(size_t n, const double *amplitudes, const std::complex<double> *phases,
+		std::complex<double> *out, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		polar_data_fast_rc(n, amplitudes, phases, out);
+	else
+		polar_data_precise(n, amplitudes, phases, out);
+}
+
+void polar_data(size_t n, const std::complex<double> *amplitudes, const std::complex<double> *phases,
+		std::complex<double> *out, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		polar_data_fast_cc(n, amplitudes, phases, out);
+	else
+		polar_data_precise(n, amplitudes, phases, out);
+}
+
+// Real powers: only the cube root is special-cased in the precise path,
+// because std::pow() returns NaN for negative bases.
+MULTIVERSION
+static void pow_data_fast(size_t n, const double *in, double *out, int numerator, int denominator)
+{
+	in = assume_aligned(in);
+	out = assume_aligned(out);
+	int abs_numerator = std::abs(numerator);
+	bool inverse = numerator < 0;
+	if (denominator == 1 && abs_numerator == 2) {
+		for (size_t i = 0; i < n; ++i) {
+			double v = in[i] * in[i];
+			out[i] = inverse ? 1.0 / v : v;
+		}
+	} else if (denominator == 1 && abs_numerator == 3) {
+		for (size_t i = 0; i < n; ++i) {
+			double v = in[i] * in[i] * in[i];
+			out[i] = inverse ? 1.0 / v : v;
+		}
+	} else if (denominator == 2 && abs_numerator == 1) {
+		for (size_t i = 0; i < n; ++i) {
+			double v = std::sqrt(in[i]);
+			out[i] = inverse ? 1.0 / v : v;
+		}
+	} else {
+		for (size_t i = 0; i < n; ++i)
+			out[i] = std::pow(in[i], double(numerator) / denominator);
+	}
+}
+
+void pow_data(size_t n, const double *in, double *out, int numerator, int denominator, MathAccuracy accuracy)
+{
+	if (denominator == 3 && std::abs(numerator) == 1) {
+		for (size_t i = 0; i < n; ++i) {
+			double v = std::cbrt(*in++);
+			*out++ = numerator < 0 ? 1.0 / v : v;
+		}
+	} else if (accuracy == MathAccuracy::fast && (denominator == 1 || denominator == 2)) {
+		pow_data_fast(n, in, out, numerator, denominator);
+	} else {
+		double exponent = double(numerator) / denominator;
+		for (size_t i = 0; i < n; ++i)
+			*out++ = std::pow(*in++, exponent);
+	}
+}
+
+// Writes the inverse of (re, im) if inverse is true.
+static inline void store_complex(double *d, size_t i, double re, double im, bool inverse)
+{
+	double norm = re * re + im * im;
+	d[2*i] = inverse ? re / norm : re;
+	d[2*i + 1] = inverse ? -im / norm : im;
+}
+
+MULTIVERSION
+static void pow_data_fast(size_t n, const std::complex<double> *in, std::complex<double> *out,
+			  int numerator, int denominator)
+{
+	const double *s = as_doubles(in);
+	double *d = as_doubles(out);
+	int abs_numerator = std::abs(numerator);
+	bool inverse = numerator < 0;
+	if (denominator == 1 && abs_numerator == 2) {
+		for (size_t i = 0; i < n; ++i) {
+			double re = s[2*i];
+			double im = s[2*i + 1];
+			store_complex(d, i, re * re - im * im, 2.0 * re * im, inverse);
+		}
+	} else if (denominator == 1 && abs_numerator == 3) {
+		for (size_t i = 0; i < n; ++i) {
+			double re = s[2*i];
+			double im = s[2*i + 1];
+			double re2 = re * re;
+			double im2 = im * im;
+			store_complex(d, i, re * (re2 - 3.0 * im2), im * (3.0 * re2 - im2), inverse);
+		}
+	} else if (denominator == 2 && abs_numerator == 1) {
+		// Principal square root. To avoid cancellation, calculate the
+		// larger component first and derive the other one by division.
+		for (size_t i = 0; i < n; ++i) {
+			double re = s[2*i];
+			double im = s[2*i + 1];
+			double r = std::sqrt(re * re + im * im);
+			double t = std::sqrt(0.5 * (r + std::abs(re)));
+			double u = t > 0.0 ? 0.5 * std::abs(im) / t : 0.0;
+			double root_re = re >= 0.0 ? t : u;
+			double root_im = std::copysign(re >= 0.0 ? u : t, im);
+			store_complex(d, i, root_re, root_im, inverse);
+		}
+	} else {
+		// Principal cube root
+		for (size_t i = 0; i < n; ++i) {
+			double re = s[2*i];
+			double im = s[2*i + 1];
+			double r = std::cbrt(std::sqrt(re * re + im * im));
+			double sin_phi, cos_phi;
+			fast_sincos(fast_atan2(im, re) * (1.0 / 3.0), sin_phi, cos_phi);
+			store_complex(d, i, r * cos_phi, r * sin_phi, inverse);
+		}
+	}
+}
+
+void pow_data(size_t n, const std::complex<double> *in, std::complex<double> *out,
+	      int numerator, int denominator, MathAccuracy accuracy)
+{
+	int abs_numerator = std::abs(numerator);
+	bool fast_path = (denominator == 1 && (abs_numerator == 2 || abs_numerator == 3)) ||
+			 ((denominator == 2 || denominator == 3) && abs_numerator == 1);
+	if (accuracy == MathAccuracy::fast && fast_path) {
+		pow_data_fast(n, in, out, numerator, denominator);
+	} else if (denominator == 1 && abs_numerator == 1) {
+		for (size_t i = 0; i < n; ++i, ++in)
+			*out++ = numerator < 0 ? 1.0 / *in : *in;
+	} else {
+		double exponent = double(numerator) / denominator;
+		for (size_t i = 0; i < n; ++i)
+			*out++ = std::pow(*in++, exponent);
+	}
+}
+
+MULTIVERSION
+static void exp_data_fast(size_t n, const double *in, double *out)
+{
+	in = assume_aligned(in);
+	out = assume_aligned(out);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = fast_exp(in[i]);
+}
+
+void exp_data(size_t n, const double *in, double *out, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		return exp_data_fast(n, in, out);
+	for (size_t i = 0; i < n; ++i)
+		*out++ = std::exp(*in++);
+}
+
+MULTIVERSION
+static void exp_data_fast(size_t n, const std::complex<double> *in, std::complex<double> *out)
+{
+	const double *s = as_doubles(in);
+	double *d = as_doubles(out);
+	for (size_t i = 0; i < n; ++i) {
+		double amp = fast_exp(s[2*i]);
+		double sin_phi, cos_phi;
+		fast_sincos(s[2*i + 1], sin_phi, cos_phi);
+		d[2*i] = amp * cos_phi;
+		d[2*i + 1] = amp * sin_phi;
+	}
+}
+
+void exp_data(size_t n, const std::complex<double> *in, std::complex<double> *out,
+	      MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		return exp_data_fast(n, in, out);
+	for (size_t i = 0; i < n; ++i)
+		*out++ = std::exp(*in++);
+}
+
+MULTIVERSION
+static void log_data_fast(size_t n, const double *in, double *out)
+{
+	in = assume_aligned(in);
+	out = assume_aligned(out);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = fast_log(in[i]);
+}
+
+void log_data(size_t n, const double *in, double *out, MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		return log_data_fast(n, in, out);
+	for (size_t i = 0; i < n; ++i)
+		*out++ = std::log(*in++);
+}
+
+// log|z| is calculated as log(max) + log(1 + (min/max)^2) / 2 to avoid
+// overflow and underflow of the squared magnitude.
+MULTIVERSION
+static void log_data_fast(size_t n, const std::complex<double> *in, std::complex<double> *out)
+{
+	const double *s = as_doubles(in);
+	double *d = as_doubles(out);
+	for (size_t i = 0; i < n; ++i) {
+		double re = s[2*i];
+		double im = s[2*i + 1];
+		double max = std::max(std::abs(re), std::abs(im));
+		double min = std::min(std::abs(re), std::abs(im));
+		double t = max > 0.0 ? min / max : 0.0;
+		d[2*i] = fast_log(max) + 0.5 * fast_log(1.0 + t * t);
+		d[2*i + 1] = fast_atan2(im, re);
+	}
+}
+
+void log_data(size_t n, const std::complex<double> *in, std::complex<double> *out,
+	      MathAccuracy accuracy)
+{
+	if (accuracy == MathAccuracy::fast)
+		return log_data_fast(n, in, out);
+	for (size_t i = 0; i < n; ++i)
+		*out++ = std::log(*in++);
+}
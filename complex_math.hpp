@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0
+// This file declares element-wise math functions on whole data blocks,
+// which are the hot loops of the Split, Merge and Pow operators.
+// It is assumed that the data is aligned according to AlignedBuf.
+//
+// Each function comes with two accuracy tiers:
+//	precise: calls the standard library for every element.
+//	fast: uses branch-free polynomial approximations (relative error
+//	      in the order of 1e-15), which the compiler can vectorize.
+//	      Trigonometric functions lose accuracy for arguments far
+//	      outside of [-pi, pi].
+// On x86-64 Linux, the fast paths are compiled for multiple instruction
+// sets and the best one is chosen at runtime.
+
+#ifndef COMPLEX_MATH_HPP
+#define COMPLEX_MATH_HPP
+
+#include <complex>
+#include <cstddef>	// For size_t
+
+enum class MathAccuracy {
+	precise,
+	fast
+};
+
+// Magnitude of complex numbers.
+void abs_data(size_t n, const std::complex<double> *in, double *out, MathAccuracy accuracy);
+
+// Magnitude and phase of complex numbers.
+// The phase is multiplied by arg_factor.
+void abs_arg_data(size_t n, const std::complex<double> *in, double *abs_out, double *arg_out,
+		  double arg_factor, MathAccuracy accuracy);
+
+// Complex numbers from magnitudes and phases. The phases are multiplied by phase_factor.
+// If the magnitudes are complex, their absolute value is used.
+void polar_data(size_t n, const double *amplitudes, const double *phases, double phase_factor,
+		std::complex<double> *out, MathAccuracy accuracy);
+void polar_data(size_t n, const std::complex<double> *amplitudes, const double *phases, double phase_factor,
+		std::complex<double> *out, MathAccuracy accuracy);
+
+// Complex numbers from magnitudes and the phases of complex numbers.
+// Since this is a simple rescaling, no trigonometric functions are needed.
+// If the magnitudes are complex, their absolute value is used.
+void polar_data(size_t n, const double *amplitudes, const std::complex<double> *phases,
+		std::complex<double> *out, MathAccuracy accuracy);
+void polar_data(size_t n, const std::complex<double> *amplitudes, const std::complex<double> *phases,
+		std::complex<double> *out, MathAccuracy accuracy);
+
+// Raise to the power of numerator / denominator. The exponents +-1, +-2, +-3,
+// +-1/2 and +-1/3 use multiplications, square and cube roots only. Other
+// exponents fall back to std::pow().
+// Note: the cube root of negative real numbers is the negative real root.
+void pow_data(size_t n, const double *in, double *out, int numerator, int denominator, MathAccuracy accuracy);
+void pow_data(size_t n, const std::complex<double> *in, std::complex<double> *out,
+	      int numerator, int denominator, MathAccuracy accuracy);
+
+// Exponential function. In the fast tier, results below the smallest
+// normal number are flushed to zero.
+void exp_data(size_t n, const double *in, double *out, MathAccuracy accuracy);
+void exp_data(size_t n, const std::complex<double> *in, std::complex<double> *out,
+	      MathAccuracy accuracy);
+
+// Natural logarithm. The logarithm of negative real numbers is NaN,
+// that of complex numbers is the principal value.
+void log_data(size_t n, const double *in, double *out, MathAccuracy accuracy);
+void log_data(size_t n, const std::complex<double> *in, std::complex<double> *out,
+	      MathAccuracy accuracy);
+
+#endif
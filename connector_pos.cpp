@@ -69,6 +69,11 @@ int ConnectorType::corner_id() const
 	return -n - 1;
 }
 
+int ConnectorType::index() const
+{
+	return n + 4;
+}
+
 bool ConnectorType::operator==(ConnectorType t) const
 {
 	return n == t.n;
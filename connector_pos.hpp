@@ -29,6 +29,9 @@ public:
 	int output_connector_id() const;
 	int corner_id() const;
 
+	// Small non-negative number that identifies the corner or connector of an operator
+	int index() const;
+
 	bool operator==(ConnectorType t) const;
 	bool operator!=(ConnectorType t) const;
 };
@@ -4,28 +4,33 @@
 #include "fft_complete.hpp"
 
 #include <fftw3.h>
+#include <algorithm>
+#include <bit>
 #include <cassert>
+#include <type_traits>
+#include <vector>
 
 ConvolutionPlan::ConvolutionPlan(FFTBuf &in1_, FFTBuf &in2_, FFTBuf &out_)
 	: in1(in1_)
 	, in2(in2_)
 	, out(out_)
+	, plan1(nullptr)
+	, plan2(nullptr)
+	, plan3(nullptr)
+	, method(Method::unknown)
+	, empty(in1.is_empty() || in2.is_empty())
 	, in1_is_complex(in1.is_complex())
 	, in2_is_complex(in2.is_complex())
 {
-
 	size_t n = in1.get_size();
 	assert(n == in2.get_size());
 	assert(n == out.get_size());
+	assert(empty || out.is_complex() == (in1_is_complex || in2_is_complex));
+}
 
-	if (in1.is_empty() || in2.is_empty()) {
-		plan1 = nullptr;
-		plan2 = nullptr;
-		plan3 = nullptr;
-		return;
-	}
-
-	assert(out.is_complex() == (in1_is_complex || in2_is_complex));
+void ConvolutionPlan::make_fft_plans()
+{
+	size_t n = in1.get_size();
 	if (in1_is_complex || in2_is_complex) {
 		mid1 = AlignedBuf<std::complex<double>>(n * n);
 		mid2 = AlignedBuf<std::complex<double>>(n * n);
@@ -88,13 +93,10 @@ ConvolutionPlan::~ConvolutionPlan()
 	fftw_destroy_plan(static_cast<fftw_plan>(plan3));
 }
 
-void ConvolutionPlan::execute()
+void ConvolutionPlan::execute_fft()
 {
-
-	if (!plan1) {
-		out.clear();
-		return;
-	}
+	if (!plan3)
+		make_fft_plans();
 
 	// Execute forward FFTs
 	fftw_execute(static_cast<fftw_plan>(plan1));
@@ -138,3 +140,271 @@ void ConvolutionPlan::execute()
 	}
 	out.set_extremes(minmax);
 }
+
+// Rough estimate of the cost of the FFT method in multiply-adds per output element.
+// The direct methods need one multiply-add per kernel element.
+static size_t max_direct_cost(size_t n)
+{
+	return 3 * (std::bit_width(n) - 1);
+}
+
+namespace {
+template <typename T>
+struct Element {
+	size_t x, y;
+	T v;
+};
+
+template <typename T>
+struct Element1D {
+	size_t pos;
+	T v;
+};
+}
+
+// Collects the non-zero elements of data. Returns false if there are more than max.
+template <typename T>
+static bool get_support(const T *data, size_t n, size_t max, std::vector<Element<T>> &res)
+{
+	res.clear();
+	for (size_t y = 0; y < n; ++y) {
+		for (size_t x = 0; x < n; ++x) {
+			T v = data[y * n + x];
+			if (v == T(0.0))
+				continue;
+			if (res.size() >= max)
+				return false;
+			res.push_back({ x, y, v });
+		}
+	}
+	return true;
+}
+
+// If data is the outer product f(y) * g(x) and f and g together have at most max
+// non-zero elements, collects these elements and returns true.
+// The non-zero elements lie in the non-zero rows times the non-zero columns.
+// The scan stops as soon as there are more than max of those.
+template <typename T>
+static bool get_separable_support(const T *data, size_t n, size_t max,
+				  std::vector<Element1D<T>> &f, std::vector<Element1D<T>> &g)
+{
+	std::vector<char> row_used(n, 0), col_used(n, 0);
+	std::vector<size_t> rows, cols;
+	size_t pivot = 0;
+	double pivot_norm = 0.0;
+	for (size_t y = 0; y < n; ++y) {
+		for (size_t x = 0; x < n; ++x) {
+			T v = data[y * n + x];
+			if (v == T(0.0))
+				continue;
+			if (!row_used[y]) {
+				row_used[y] = 1;
+				rows.push_back(y);
+			}
+			if (!col_used[x]) {
+				col_used[x] = 1;
+				cols.push_back(x);
+			}
+			if (rows.size() + cols.size() > max)
+				return false;
+			double norm = std::norm(v);
+			if (norm > pivot_norm) {
+				pivot = y * n + x;
+				pivot_norm = norm;
+			}
+		}
+	}
+	if (pivot_norm == 0.0)
+		return false;
+	std::sort(cols.begin(), cols.end());
+
+	// Factorize using the row and column of the largest element
+	size_t p = pivot / n, q = pivot % n;
+	std::vector<T> f_full(n, T(0.0)), g_full(n, T(0.0));
+	f.clear();
+	g.clear();
+	for (size_t y: rows) {
+		f_full[y] = data[y * n + q];
+		if (f_full[y] != T(0.0))
+			f.push_back({ y, f_full[y] });
+	}
+	for (size_t x: cols) {
+		g_full[x] = data[p * n + x] / data[pivot];
+		if (g_full[x] != T(0.0))
+			g.push_back({ x, g_full[x] });
+	}
+
+	// Check the factorization. Outside of the non-zero rows and columns, both sides are zero.
+	// Tolerate rounding errors, e.g. of exp(a + b) vs. exp(a) * exp(b).
+	double tolerance = 1e-12 * sqrt(pivot_norm);
+	for (size_t y: rows) {
+		for (size_t x: cols) {
+			if (std::abs(data[y * n + x] - f_full[y] * g_full[x]) > tolerance)
+				return false;
+		}
+	}
+	return true;
+}
+
+// dst[x] += v * src[x - shift], cyclically
+template <typename TS, typename TO>
+static void add_shifted_line(TO *dst, const TS *src, size_t n, size_t shift, TO v)
+{
+	for (size_t x = 0; x < shift; ++x)
+		dst[x] += v * src[x + n - shift];
+	for (size_t x = shift; x < n; ++x)
+		dst[x] += v * src[x - shift];
+}
+
+// The FFT method yields n times the cyclic convolution (see the normalization in execute_fft()).
+template <typename TA, typename TB, typename TO>
+static void convolve_sparse(const std::vector<Element<TA>> &a, const TB *b, TO *out, size_t n)
+{
+	size_t mask = n - 1;
+	double factor = static_cast<double>(n);
+	std::fill(out, out + n * n, TO(0.0));
+	for (const Element<TA> &e: a) {
+		TO v = TO(e.v) * factor;
+		for (size_t y = 0; y < n; ++y)
+			add_shifted_line(out + y * n, b + ((y - e.y) & mask) * n, n, e.x, v);
+	}
+}
+
+template <typename TA, typename TB, typename TO>
+static void convolve_separable(const std::vector<Element1D<TA>> &f, const std::vector<Element1D<TA>> &g,
+			       const TB *b, TO *temp, TO *out, size_t n)
+{
+	// Convolve the rows with g, then the columns with f
+	size_t mask = n - 1;
+	double factor = static_cast<double>(n);
+	std::fill(temp, temp + n * n, TO(0.0));
+	for (size_t y = 0; y < n; ++y) {
+		for (const Element1D<TA> &e: g)
+			add_shifted_line(temp + y * n, b + y * n, n, e.pos, TO(e.v));
+	}
+	std::fill(out, out + n * n, TO(0.0));
+	for (const Element1D<TA> &e: f) {
+		TO v = TO(e.v) * factor;
+		for (size_t y = 0; y < n; ++y)
+			add_shifted_line(out + y * n, temp + ((y - e.pos) & mask) * n, n, 0, v);
+	}
+}
+
+template <typename TO>
+TO *ConvolutionPlan::get_direct_temp()
+{
+	if (!direct_temp)
+		direct_temp = std::make_unique<FFTBuf>(out.is_complex(), out.get_size());
+	return direct_temp->get_data<TO>();
+}
+
+// If the method is known, only the kernel is collected from the current data.
+// If the kernel turned dense, fall back to the FFT.
+template <typename T1, typename T2, typename TO>
+bool ConvolutionPlan::execute_direct_doit()
+{
+	size_t n = in1.get_size();
+	size_t max_cost = max_direct_cost(n);
+	const T1 *a = in1.get_data<T1>();
+	const T2 *b = in2.get_data<T2>();
+	TO *res = out.get_data<TO>();
+
+	std::vector<Element<T1>> support1;
+	std::vector<Element<T2>> support2;
+	std::vector<Element1D<T1>> f1, g1;
+	std::vector<Element1D<T2>> f2, g2;
+	switch (method) {
+	case Method::unknown: {
+		// Shift and add the input with fewer non-zero elements
+		bool sparse1 = get_support(a, n, max_cost, support1);
+		bool sparse2 = get_support(b, n, sparse1 ? support1.size() : max_cost, support2);
+		if (sparse2) {
+			method = Method::sparse2;
+			convolve_sparse(support2, a, res, n);
+			return true;
+		}
+		if (sparse1) {
+			method = Method::sparse1;
+			convolve_sparse(support1, b, res, n);
+			return true;
+		}
+		if (get_separable_support(a, n, max_cost, f1, g1)) {
+			method = Method::separable1;
+			convolve_separable(f1, g1, b, get_direct_temp<TO>(), res, n);
+			return true;
+		}
+		if (get_separable_support(b, n, max_cost, f2, g2)) {
+			method = Method::separable2;
+			convolve_separable(f2, g2, a, get_direct_temp<TO>(), res, n);
+			return true;
+		}
+		break;
+	}
+	case Method::sparse1:
+		if (!get_support(a, n, max_cost, support1))
+			break;
+		convolve_sparse(support1, b, res, n);
+		return true;
+	case Method::sparse2:
+		if (!get_support(b, n, max_cost, support2))
+			break;
+		convolve_sparse(support2, a, res, n);
+		return true;
+	case Method::separable1:
+		if (!get_separable_support(a, n, max_cost, f1, g1))
+			break;
+		convolve_separable(f1, g1, b, get_direct_temp<TO>(), res, n);
+		return true;
+	case Method::separable2:
+		if (!get_separable_support(b, n, max_cost, f2, g2))
+			break;
+		convolve_separable(f2, g2, a, get_direct_temp<TO>(), res, n);
+		return true;
+	case Method::fft:
+		return false;
+	}
+	method = Method::fft;
+	return false;
+}
+
+void ConvolutionPlan::reset_method()
+{
+	method = Method::unknown;
+}
+
+bool ConvolutionPlan::execute_direct()
+{
+	using C = std::complex<double>;
+	if (in1_is_complex && in2_is_complex)
+		return execute_direct_doit<C, C, C>();
+	if (in1_is_complex)
+		return execute_direct_doit<C, double, C>();
+	if (in2_is_complex)
+		return execute_direct_doit<double, C, C>();
+	return execute_direct_doit<double, double, double>();
+}
+
+void ConvolutionPlan::execute()
+{
+	if (empty) {
+		out.clear();
+		return;
+	}
+	if (!execute_direct()) {
+		execute_fft();
+		return;
+	}
+
+	Extremes minmax;
+	size_t n = out.get_size();
+	if (out.is_complex()) {
+		std::complex<double> *data = out.get_complex_data();
+		for (size_t i = 0; i < n * n; ++i)
+			minmax.reg(*data++, 1.0);
+	} else {
+		double *data = out.get_real_data();
+		for (size_t i = 0; i < n * n; ++i)
+			minmax.reg(*data++, 1.0);
+	}
+	out.set_extremes(minmax);
+}
@@ -3,12 +3,23 @@
 // Fourier transforms, followed by an inverse Fourier transform.
 // The input buffers can be either real or complex. If at least one
 // of the input buffers is complex, so must be the output buffer.
+//
+// If one of the inputs has only few non-zero elements (e.g. a lattice or
+// a few painted dots) or is the product of two such 1D functions (e.g. a
+// rectangular lattice), the convolution is calculated directly by shifting
+// and adding the other input, which is cheaper than three FFTs. The scan of the
+// inputs stops as soon as an input turns out to be dense. The chosen method is
+// kept until reset_method() is called, i.e. when the structure of the inputs may
+// have changed or is unknown. Only the kernel of a direct method is collected on every execution.
+// If it turned dense, the FFT is used from then on. The FFT plans are only created
+// when first needed.
 #ifndef CONVOLUTION_PLAN_HPP
 #define CONVOLUTION_PLAN_HPP
 
 #include "aligned_buf.hpp"
 
 #include <complex>
+#include <memory>
 
 class FFTBuf;
 
@@ -19,16 +30,33 @@ class ConvolutionPlan {
 	AlignedBuf<std::complex<double>> mid2;
 	AlignedBuf<std::complex<double>> temp;	// Intermediate buffer for real to complex transforms
 	FFTBuf &out;
-	void *plan1;				// nullptr if input is empty (i.e. generate empty output)
-	void *plan2;				// nullptr if input is empty (i.e. generate empty output)
-	void *plan3;				// nullptr if input is empty (i.e. generate empty output)
+	void *plan1;				// nullptr if not yet planned
+	void *plan2;				// nullptr if not yet planned
+	void *plan3;				// nullptr if not yet planned
+	enum class Method {
+		unknown,			// Not yet decided
+		fft,
+		sparse1, sparse2,		// Shift and add the non-zero elements of input 1 or 2
+		separable1, separable2		// Input 1 or 2 is the outer product of two sparse 1D functions
+	} method;
+	bool empty;				// Input is empty (i.e. generate empty output)
 	bool in1_is_complex;
 	bool in2_is_complex;
+	std::unique_ptr<FFTBuf> direct_temp;	// Intermediate buffer for separable convolution
+
+	void make_fft_plans();
+	void execute_fft();
+	bool execute_direct();
+	template <typename T1, typename T2, typename TO>
+	bool execute_direct_doit();
+	template <typename TO>
+	TO *get_direct_temp();
 public:
 	ConvolutionPlan(FFTBuf &in1, FFTBuf &in2, FFTBuf &out);
 	~ConvolutionPlan();
 
 	void execute();
+	void reset_method();
 };
 
 #endif
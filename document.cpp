@@ -5,8 +5,14 @@
 #include "operator.hpp"
 #include "mainwindow.hpp"
 #include "edge.hpp"
+#include "command.hpp"
+#include "binary_document.hpp"
+#include "undo_store.hpp"
+#include "version.hpp"
 
 #include <QAction>
+#include <QBuffer>
+#include <QCryptographicHash>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QJsonObject>
@@ -15,14 +21,22 @@
 #include <QUndoStack>
 #include <QUndoCommand>
 
+#include <algorithm>
+#include <array>
+
 Document::Document(const Document *previous_document, MainWindow &w)
-	: undo_stack(new QUndoStack)
+	: undo_store(std::make_unique<UndoStore>())
+	, undo_stack(new QUndoStack)
 	, fft_size(256)
 {
 	static int number = 0;
 	name = "New document " + QString::number(++number);
 
 	QObject::connect(undo_stack.get(), &QUndoStack::cleanChanged, [&w]() { w.set_title(); });
+	QObject::connect(undo_stack.get(), &QUndoStack::indexChanged, [this]() { pack_undo_stack(); });
+	pack_timer.setSingleShot(true);
+	pack_timer.setInterval(pack_interval);
+	QObject::connect(&pack_timer, &QTimer::timeout, [this]() { pack_undo_stack(); });
 
 	if (previous_document)
 		fft_size = previous_document->fft_size;
@@ -54,7 +68,7 @@ bool Document::save_as(MainWindow *w, Scene *scene)
 {
 
 	QString fn = QFileDialog::getSaveFileName(nullptr, "Save File", get_directory(),
-						  "XFFT Files (*.xfft)");
+						  "XFFT Files (*.xfft);;XFFT Binary Files (*.xfftb)");
 	return save(fn, w, scene);
 }
 
@@ -66,6 +80,21 @@ bool Document::save(const QString &fn, MainWindow *w, Scene *scene)
 		return false;
 	}
 
+	bool binary = QFileInfo(fn).suffix() == binary_document_suffix;
+	QByteArray data = serialize(w, scene, binary);
+	if (!out.write(data)) {
+		QMessageBox::warning(nullptr, "Error", "Couldn't write to file.");
+		out.close();
+		QFile::remove(fn);
+		return false;
+	}
+	set_filename(fn);
+	undo_stack->setClean();
+	return true;
+}
+
+QByteArray Document::serialize(MainWindow *w, Scene *scene, bool binary) const
+{
 	QJsonObject json;
 
 	// Fill global data
@@ -77,10 +106,16 @@ bool Document::save(const QString &fn, MainWindow *w, Scene *scene)
 	json["size_y"] = w->size().height();
 
 	// Write operators
+	std::vector<std::vector<QString>> binary_fields;
 	{
 		QJsonArray ops;
-		for (const Operator *op: topo.get_operators())
+		for (const Operator *op: topo.get_operators()) {
 			ops.push_back(op->to_json());
+			std::vector<QString> fields;
+			for (const char *field: op->get_state().binary_fields())
+				fields.push_back(QStringLiteral("state/") + field);
+			binary_fields.push_back(std::move(fields));
+		}
 		json["operators"] = ops;
 	}
 
@@ -92,22 +127,120 @@ bool Document::save(const QString &fn, MainWindow *w, Scene *scene)
 		json["edges"] = edges;
 	}
 
-	QJsonDocument json_doc(json);
-	if (!out.write(json_doc.toJson())) {
-		QMessageBox::warning(nullptr, "Error", "Couldn't write to file.");
-		out.close();
-		QFile::remove(fn);
-		return false;
+	if (Globals::get_embed_results())
+		embed_results(json, binary_fields);
+
+	return binary ? document_to_binary(json, binary_fields)
+		      : QJsonDocument(json).toJson();
+}
+
+// Binary field, which is a chunk in binary documents and a base64 string in text documents.
+static QByteArray get_binary_field(const QJsonValue &v, const std::vector<QByteArray> &chunks)
+{
+	if (std::optional<QByteArray> chunk = get_chunk(v, chunks))
+		return *chunk;
+	return QByteArray::fromBase64(v.toString().toLatin1());
+}
+
+// Hash of the type and state of each operator and of all operators upstream.
+// Used to verify that results embedded in a file belong to the document.
+// The hash includes the program version, because calculations might change.
+// Binary fields are hashed in their raw form, so that the hash doesn't depend on the format.
+static std::vector<QByteArray> result_hashes(const QJsonObject &json, const std::vector<Operator *> &operators,
+					     const std::vector<QByteArray> &chunks)
+{
+	QJsonArray ops = json["operators"].toArray();
+	size_t num_ops = ops.size();
+
+	// Inputs of each operator as (input connector, operator from, output connector).
+	// Since operators are saved in topological order, inputs precede the operator.
+	std::vector<std::vector<std::array<int, 3>>> inputs(num_ops);
+	for (const QJsonValue &v: json["edges"].toArray()) {
+		QJsonObject desc = v.toObject();
+		int op_from = desc["op_from"].toInt(-1);
+		int op_to = desc["op_to"].toInt(-1);
+		if (op_from < 0 || op_to <= op_from || static_cast<size_t>(op_to) >= num_ops)
+			continue;
+		inputs[op_to].push_back({ desc["conn_to"].toInt(), op_from, desc["conn_from"].toInt() });
 	}
-	set_filename(fn);
-	undo_stack->setClean();
-	return true;
+
+	std::vector<QByteArray> res(num_ops);
+	for (size_t i = 0; i < num_ops; ++i) {
+		QJsonObject desc = ops[i].toObject();
+		QJsonObject state = desc["state"].toObject();
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		hash.addData(QByteArray(version));
+		hash.addData(QByteArray::number(json["fft_size"].toInt()));
+		if (i < operators.size()) {
+			for (const char *field: operators[i]->get_state().binary_fields()) {
+				hash.addData(get_binary_field(state[field], chunks));
+				state.remove(field);
+			}
+		}
+		hash.addData(QJsonDocument(QJsonObject{ { "type", desc["type"] }, { "state", state } })
+				.toJson(QJsonDocument::Compact));
+		std::sort(inputs[i].begin(), inputs[i].end());
+		for (auto [conn_to, op_from, conn_from]: inputs[i]) {
+			hash.addData(QByteArray::number(conn_to));
+			hash.addData(res[op_from]);
+			hash.addData(QByteArray::number(conn_from));
+		}
+		res[i] = hash.result();
+	}
+	return res;
+}
+
+void Document::embed_results(QJsonObject &json, std::vector<std::vector<QString>> &binary_fields) const
+{
+	const std::vector<Operator *> &operators = topo.get_operators();
+	std::vector<QByteArray> hashes = result_hashes(json, operators, {});
+	QJsonArray ops = json["operators"].toArray();
+	for (size_t i = 0; i < operators.size(); ++i) {
+		// Off-screen views may not be calculated. They are recalculated on load.
+		if (operators[i]->is_dirty())
+			continue;
+		QImage image = operators[i]->get_result_image();
+		if (image.isNull())
+			continue;
+		QByteArray png;
+		QBuffer buffer(&png);
+		buffer.open(QIODevice::WriteOnly);
+		if (!image.save(&buffer, "PNG"))
+			continue;
+		QJsonObject desc = ops[i].toObject();
+		desc["result"] = QJsonObject {
+			{ "hash", QString::fromLatin1(hashes[i].toHex()) },
+			{ "image", QString::fromLatin1(png.toBase64()) }
+		};
+		ops[i] = desc;
+		binary_fields[i].push_back(QStringLiteral("result/image"));
+	}
+	json["operators"] = ops;
+}
+
+bool Document::restore_results(const QJsonObject &json, const std::vector<QByteArray> &chunks)
+{
+	std::vector<QByteArray> hashes = result_hashes(json, topo.get_operators(), chunks);
+	QJsonArray ops = json["operators"].toArray();
+	bool restored = false;
+	for (size_t i = 0; i < hashes.size(); ++i) {
+		QJsonObject result = ops[i].toObject()["result"].toObject();
+		if (result.isEmpty() || QByteArray::fromHex(result["hash"].toString().toLatin1()) != hashes[i])
+			continue;
+		QImage image;
+		Operator *op = topo.get_by_id(i);
+		if (!op || !image.loadFromData(get_binary_field(result["image"], chunks), "PNG"))
+			continue;
+		op->set_result_image(image);
+		restored = true;
+	}
+	return restored;
 }
 
 void Document::load(MainWindow *w, Scene *scene)
 {
 	QString fn = QFileDialog::getOpenFileName(nullptr, "Open File", get_directory(),
-						  "XFFT Files (*.xfft)");
+						  "XFFT Files (*.xfft *.xfftb)");
 	if (fn.isEmpty())
 		return;
 	load(w, scene, fn);
@@ -168,9 +301,34 @@ void Document::load(MainWindow *w, Scene *scene, QFile &in, const QString &fn)
 // Return true on success
 bool Document::load_doit(MainWindow *w, Scene *scene, QFile &in, const QString &fn)
 {
-	QByteArray data = in.readAll();
-	QJsonDocument json_doc = QJsonDocument::fromJson(data);
-	QJsonObject json = json_doc.object();
+	// Map the file if possible. This fails for example for compressed resources.
+	QByteArray data;
+	uchar *mapped = in.map(0, in.size());
+	const uchar *ptr = mapped;
+	size_t size = in.size();
+	if (!mapped) {
+		data = in.readAll();
+		ptr = reinterpret_cast<const uchar *>(data.constData());
+		size = data.size();
+	}
+
+	// In binary documents, binary fields are chunks, which are passed to the operators as is.
+	QJsonObject json;
+	std::vector<QByteArray> chunks;
+	if (is_binary_document(ptr, size)) {
+		std::optional<BinaryDocument> res = binary_to_document(ptr, size);
+		if (!res) {
+			QMessageBox::warning(nullptr, "Error", "Corrupt binary file");
+			return false;
+		}
+		json = std::move(res->json);
+		chunks = std::move(res->chunks);
+	} else {
+		QByteArray text = QByteArray::fromRawData(reinterpret_cast<const char *>(ptr), size);
+		json = QJsonDocument::fromJson(text).object();
+	}
+	if (mapped)
+		in.unmap(mapped);
 
 	size_t fft_size = static_cast<size_t>(json["fft_size"].toInt());
 	if (std::find(std::begin(supported_fft_sizes), std::end(supported_fft_sizes), fft_size)
@@ -186,26 +344,40 @@ bool Document::load_doit(MainWindow *w, Scene *scene, QFile &in, const QString &
 	scene->set_scroll_position(scroll_pos);
 	change_fft_size(fft_size, scene);
 
-	// Load operators
+	// Load operators. The operators are added to the operator list in one go,
+	// which avoids recalculating the visibility graph for every operator.
 	{
 		QJsonArray ops = json["operators"].toArray();
+		std::vector<Operator *> new_ops;
+		new_ops.reserve(ops.size());
 		for (const QJsonValue &op_desc: ops) {
-			Operator *op = Operator::from_json(*w, op_desc.toObject());
+			Operator *op = Operator::from_json(*w, op_desc.toObject(), true, chunks);
 			if (!op) {
+				operator_list.add_bulk(new_ops, *scene);
 				QMessageBox::warning(nullptr, "Error", "Invalid operator");
 				return false;
 			}
+			new_ops.push_back(op);
 		}
+		operator_list.add_bulk(new_ops, *scene);
 	}
 
-	// Load edges
+	// If there are valid embedded results, show them and recalculate lazily.
+	bool deferred = restore_results(json, chunks);
+
+	// Load edges. First create all edges, then route them in parallel.
+	// Adding the edges doesn't calculate anything, this is done in one go at the end.
 	{
 		QJsonArray edges = json["edges"].toArray();
+		std::vector<Edge *> new_edges;
+		new_edges.reserve(edges.size());
 		for (const QJsonValue &v: edges) {
 			QJsonObject desc = v.toObject();
 			Operator *op_from = topo.get_by_id(desc["op_from"].toInt());
 			Operator *op_to = topo.get_by_id(desc["op_to"].toInt());
 			if (!op_from || !op_to) {
+				for (Edge *e: new_edges)
+					delete e;
 				QMessageBox::warning(nullptr, "Error", "Invalid edge");
 				return false;
 			}
@@ -214,15 +386,28 @@ bool Document::load_doit(MainWindow *w, Scene *scene, QFile &in, const QString &
 
 			auto e = std::make_unique<Edge>(&conn_from, &conn_to, *this);
 			scene->addItem(&*e);
-			e->recalculate();
-			e->add_connection();
-			e.release();
+			new_edges.push_back(e.release());
 		}
+
+		Edge::recalculate(new_edges);
+
+		topo.set_suspended(true);
+		for (Edge *e: new_edges)
+			e->add_connection();
+		topo.set_suspended(false);
 	}
 
-	// Update buffers and execute
+	// Update buffers and execute. With restored results, the operators are
+	// only marked as dirty: the visible ones are calculated on demand, the
+	// others in idle time. The views show the restored images until then.
 	topo.update_all_buffers();
-	topo.execute_all();
+	if (deferred) {
+		topo.mark_all_dirty();
+		scene->update_demand();
+		scene->calculate_in_idle_time();
+	} else {
+		topo.execute_all();
+	}
 
 	if (!fn.isEmpty())
 		set_filename(fn);
@@ -273,6 +458,16 @@ void Document::place_command_internal(QUndoCommand *cmd)
 	undo_stack->push(cmd);
 }
 
+void Document::discard_last_command()
+{
+	int idx = undo_stack->index() - 1;
+	if (idx < 0)
+		return;
+	// QUndoStack deletes commands that are obsolete after undo().
+	const_cast<QUndoCommand *>(undo_stack->command(idx))->setObsolete(true);
+	undo_stack->undo();
+}
+
 QAction *Document::undo_action(QObject *parent) const
 {
 	return undo_stack->createUndoAction(parent);
@@ -287,3 +482,69 @@ bool Document::changed() const
 {
 	return !undo_stack->isClean();
 }
+
+UndoStore &Document::get_undo_store()
+{
+	return *undo_store;
+}
+
+// QUndoStack only gives out const pointers, but the commands are owned by us.
+static PackableCommand *get_packable(const QUndoStack &stack, int idx)
+{
+	if (idx < 0 || idx >= stack.count())
+		return nullptr;
+	return dynamic_cast<PackableCommand *>(const_cast<QUndoCommand *>(stack.command(idx)));
+}
+
+void Document::pack_undo_stack()
+{
+	// Walk from the current position outward. The next command to
+	// undo and the next command to redo are never packed, because
+	// they are most likely to be used and may still be merged into.
+	int index = undo_stack->index();
+	int count = undo_stack->count();
+	size_t uncompressed = 0;
+	size_t compressed = 0;
+	bool compressing = false;
+	for (int dist = 0; index - 1 - dist >= 0 || index + dist < count; ++dist) {
+		for (int idx: { index - 1 - dist, index + dist }) {
+			PackableCommand *cmd = get_packable(*undo_stack, idx);
+			if (!cmd)
+				continue;
+			if (!cmd->is_packed()) {
+				uncompressed += cmd->raw_size();
+				if (dist == 0 || uncompressed <= undo_uncompressed_budget)
+					continue;
+				cmd->pack();
+			}
+			cmd->poll();
+			if (cmd->is_spilled())
+				continue;
+			// The compressed size is not known yet. Never block on the compression.
+			if (cmd->is_compressing()) {
+				compressing = true;
+				continue;
+			}
+			compressed += cmd->memory_usage();
+			if (compressed > undo_compressed_budget)
+				cmd->spill();
+		}
+	}
+	if (compressing)
+		pack_timer.start();
+}
+
+Document::UndoFootprint Document::get_undo_footprint()
+{
+	UndoFootprint res { 0, 0, 0 };
+	for (int idx = 0; idx < undo_stack->count(); ++idx) {
+		if (PackableCommand *cmd = get_packable(*undo_stack, idx)) {
+			cmd->poll();
+			res.memory += cmd->memory_usage();
+			if (cmd->is_compressing())
+				res.compressing += cmd->memory_usage();
+			res.disk += cmd->disk_usage();
+		}
+	}
+	return res;
+}
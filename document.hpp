@@ -7,14 +7,20 @@
 
 #include <cstddef>
 #include <memory>
+#include <vector>
 
+#include <QByteArray>
 #include <QString>
+#include <QTimer>
 
 class MainWindow;
 class QAction;
+class QByteArray;
 class QFile;
+class QJsonObject;
 class QUndoStack;
 class QUndoCommand;
+class UndoStore;
 
 class Document {
 	bool save(const QString &fn, MainWindow *w, Scene *scene); // Returns true if file actually saved
@@ -23,8 +29,27 @@ class Document {
 	// Get directory either from current file or from globals
 	QString get_directory() const;
 
+	// The store must outlive the commands on the undo stack.
+	std::unique_ptr<UndoStore> undo_store;
 	std::unique_ptr<QUndoStack> undo_stack;
 	void place_command_internal(QUndoCommand *cmd); // Takes ownership of cmd
+
+	// Bound the memory use of the undo stack: Data of commands that exceed the
+	// first budget are compressed. Compressed data that exceeds the second budget
+	// is spilled to disk. Commands close to the current position are counted first.
+	// Commands that are still being compressed are not counted against the second
+	// budget. Instead, the stack is packed again after pack_interval.
+	static constexpr size_t undo_uncompressed_budget = 64 * 1024 * 1024;
+	static constexpr size_t undo_compressed_budget = 64 * 1024 * 1024;
+	static constexpr int pack_interval = 200;	// ms
+	QTimer pack_timer;
+	void pack_undo_stack();
+
+	// Embedded results: images of views, which are shown while the document
+	// is recalculated after loading. embed_results() adds the paths of the
+	// images to binary_fields. restore_results() returns true if any result was used.
+	void embed_results(QJsonObject &json, std::vector<std::vector<QString>> &binary_fields) const;
+	bool restore_results(const QJsonObject &json, const std::vector<QByteArray> &chunks);
 public:
 	TopologicalOrder topo;
 	OperatorList operator_list;
@@ -41,6 +66,9 @@ public:
 	QString name;
 	size_t fft_size;
 
+	// Returns the document in the text or binary file format
+	QByteArray serialize(MainWindow *w, Scene *scene, bool binary) const;
+
 	bool save(MainWindow *w, Scene *scene);
 	bool save_as(MainWindow *w, Scene *scene);
 	void load(MainWindow *w, Scene *scene);
@@ -59,8 +87,20 @@ public:
 	QAction *redo_action(QObject *parent) const;
 	bool changed() const;
 
+	UndoStore &get_undo_store();
+	struct UndoFootprint {
+		size_t memory;		// Uncompressed and compressed data
+		size_t compressing;	// Part of memory that is still being compressed
+		size_t disk;		// Spilled data
+	};
+	UndoFootprint get_undo_footprint();	// Collects finished compressions
+
 	template<typename Command, typename... Args>
 	void place_command(Args&&... args);
+
+	// Undo the last command and remove it from the stack, so that it can't be redone.
+	// Used to cancel an interaction that already placed its command.
+	void discard_last_command();
 };
 
 #include "document_impl.hpp"
@@ -6,12 +6,17 @@
 #include "document.hpp"
 #include "topological_order.hpp"
 #include "globals.hpp"
+#include "parallel.hpp"
 
 #include <QCursor>
 #include <QGraphicsSceneMouseEvent>
 
+#include <algorithm>
 #include <cassert>
-#include <boost/heap/binomial_heap.hpp>
+#include <boost/heap/d_ary_heap.hpp>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
 
 enum class EdgeMode {
 	unplaced, placed, selected, replace
@@ -43,6 +48,7 @@ Edge::Edge(Connector *connector_from_, Document &document_)
 	: document(document_)
 	, connector_from(connector_from_)
 	, connector_to(nullptr)
+	, move_tree_from_input(false)
 	, comp(false)
 	, can_be_placed(false)
 	, replace_edge(nullptr)
@@ -65,6 +71,7 @@ Edge::Edge(Connector *connector_from_, Connector *connector_to_, Document &docum
 	: document(document_)
 	, connector_from(connector_from_)
 	, connector_to(connector_to_)
+	, move_tree_from_input(false)
 	, comp(connector_from->is_complex_buffer())
 	, can_be_placed(false)
 	, replace_edge(nullptr)
@@ -94,6 +101,23 @@ void Edge::mousePressEvent(QGraphicsSceneMouseEvent *event)
 }
 
 // What follows is a simple implementation of the A* algorithm.
+struct TreeEntry;
+
+struct IndirectTreeEntry {
+	TreeEntry *entry;
+public:
+	IndirectTreeEntry(TreeEntry *);
+	bool operator<(const IndirectTreeEntry &e2) const;
+	TreeEntry &operator*();
+	TreeEntry *operator->();
+	const TreeEntry &operator*() const;
+	const TreeEntry *operator->() const;
+};
+
+// A 4-ary heap is shallower than a binary heap and more cache friendly than
+// node based heaps. It is mutable, so that we can update entries via their handle.
+using heap_t = boost::heap::d_ary_heap<IndirectTreeEntry, boost::heap::arity<4>, boost::heap::mutable_<true>>;
+
 struct TreeEntry {
 	const TreeEntry	*parent;		// nullptr: at root
 	ViewConnection *view_connection;	// By which connection we got there
@@ -102,22 +126,18 @@ struct TreeEntry {
 	double		dist;			// Distance travelled from source
 	double		estimate;		// Estimated total distance
 	bool		closed;			// True: we found optimal path to this entry
+	heap_t::handle_type handle;		// Position in open list, valid if not closed
 
 	TreeEntry(const TreeEntry *parent, ViewConnection *view_connection,
 		  const ConnectorDesc &conn_, const QPointF &pos, double dist, double estimate);
 	bool operator<(const TreeEntry &e2) const;
 };
 
-struct IndirectTreeEntry {
-	TreeEntry *entry;
-public:
-	IndirectTreeEntry(TreeEntry *);
-	bool operator<(const IndirectTreeEntry &e2) const;
-	bool operator==(const IndirectTreeEntry &e2) const;
-	TreeEntry &operator*();
-	TreeEntry *operator->();
-	const TreeEntry &operator*() const;
-	const TreeEntry *operator->() const;
+struct ConnectorDescHash {
+	size_t operator()(const ConnectorDesc &desc) const
+	{
+		return std::hash<const Operator *>()(desc.op) ^ static_cast<size_t>(desc.type.index());
+	}
 };
 
 class PathFinder
@@ -126,11 +146,21 @@ class PathFinder
 	QPointF target_pos;
 	QPointF from_pos;
 
+	// The index in the entries vector is the id of a node. The nodes map gives
+	// the id of already visited corners and connectors.
 	std::vector<TreeEntry> entries;
-	using heap_t = boost::heap::binomial_heap<IndirectTreeEntry>;
+	std::unordered_map<ConnectorDesc, size_t, ConnectorDescHash> nodes;
 	heap_t open_list;
 	TreeEntry	*final_entry;
 
+	// In tree mode, shortest paths from the root to all corners are calculated.
+	bool tree_mode;
+	QPointF root_pos;
+
+	// Statistics, printed in debug mode
+	size_t num_expanded;
+	std::chrono::steady_clock::duration time;
+
 	void iterate();
 	double heuristics(const QPointF &) const;
 	void expand(const TreeEntry *parent, const ConnectorDesc &from, const OperatorList::view_list &view_list);
@@ -138,10 +168,16 @@ public:
 	PathFinder(Connector *target, const QPointF &target_pos, const OperatorList &operator_list);
 	void calculate(const std::vector<CornerDistance> &corner_distances, const QPointF &from_pos);
 	void calculate(const ConnectorDesc &connector_from, const QPointF &from_pos_);
+	void calculate_tree(const ConnectorDesc &root, const QPointF &root_pos);
+	bool route_from_tree(const std::vector<CornerDistance> &corner_distances, const QPointF &pos,
+			     std::vector<QPointF> &lines);
 	void to_lines(std::vector<QPointF> &lines) const;
 	void register_view_connections(Edge *e) const;
 	void add_entry(const TreeEntry *parent, ViewConnection *view_connection,
 		       const ConnectorDesc &conn, const QPointF &pos, double dist, double estimate);
+	size_t get_num_expanded() const;
+	size_t get_num_visited() const;
+	std::chrono::steady_clock::duration get_time() const;
 };
 
 TreeEntry::TreeEntry(const TreeEntry *parent_, ViewConnection *view_connection_,
@@ -173,11 +209,6 @@ bool IndirectTreeEntry::operator<(const IndirectTreeEntry &e2) const
 	return *entry < *(e2.entry);
 }
 
-bool IndirectTreeEntry::operator==(const IndirectTreeEntry &e2) const
-{
-	return entry == e2.entry;
-}
-
 TreeEntry &IndirectTreeEntry::operator*()
 {
 	return *entry;
@@ -202,10 +233,14 @@ PathFinder::PathFinder(Connector *target_, const QPointF &target_pos_, const Ope
 	: target(target_->connector_desc())
 	, target_pos(target_pos_)
 	, final_entry(nullptr)
+	, tree_mode(false)
+	, num_expanded(0)
+	, time(0)
 {
 	size_t num_operators = operator_list.num_operators();
 	entries.reserve(num_operators * 4 + 2);
-	//open_list.reserve(num_operators * 4 + 2);
+	nodes.reserve(num_operators * 4 + 2);
+	open_list.reserve(num_operators * 4 + 2);
 }
 
 void PathFinder::add_entry(const TreeEntry *parent, ViewConnection *view_connection,
@@ -214,27 +249,78 @@ void PathFinder::add_entry(const TreeEntry *parent, ViewConnection *view_connect
 	// We use pointers to elements in a vector. Therefore the vector must never grow.
 	assert(entries.capacity() >= entries.size() + 1);
 
+	nodes.emplace(conn, entries.size());
 	TreeEntry &e = entries.emplace_back(parent, view_connection, conn, pos, dist, estimate);
-	open_list.push(IndirectTreeEntry(&e));
+	e.handle = open_list.push(IndirectTreeEntry(&e));
 }
 
 void PathFinder::calculate(const std::vector<CornerDistance> &corner_distances, const QPointF &from_pos_)
 {
+	auto start = std::chrono::steady_clock::now();
 	from_pos = from_pos_;
 	for (const CornerDistance &corner: corner_distances)
 		add_entry(nullptr, nullptr, corner.conn, corner.pos, corner.d, corner.d + heuristics(corner.pos));
 	iterate();
+	time += std::chrono::steady_clock::now() - start;
 }
 
 void PathFinder::calculate(const ConnectorDesc &connector_from, const QPointF &from_pos_)
 {
+	auto start = std::chrono::steady_clock::now();
 	from_pos = from_pos_;
 	expand(nullptr, connector_from, connector_from.op->get_view_list(connector_from.type));
 	iterate();
+	time += std::chrono::steady_clock::now() - start;
+}
+
+// Calculate the shortest paths from a connector to all corners (i.e. Dijkstra's algorithm).
+// This is used when moving an operator: the edges connected to it have one fixed end
+// and the graph does not change. Then, routing to a new position needs only a lookup.
+void PathFinder::calculate_tree(const ConnectorDesc &root, const QPointF &root_pos_)
+{
+	auto start = std::chrono::steady_clock::now();
+	tree_mode = true;
+	root_pos = root_pos_;
+	expand(nullptr, root, root.op->get_view_list(root.type));
+	iterate();
+	time += std::chrono::steady_clock::now() - start;
+}
+
+// After calculate_tree(): Append the shortest path from the root to a position, from which
+// the given corners can be seen. Returns false if none of the corners can be reached.
+bool PathFinder::route_from_tree(const std::vector<CornerDistance> &corner_distances, const QPointF &pos,
+				 std::vector<QPointF> &lines)
+{
+	assert(tree_mode);
+	final_entry = nullptr;
+	double best_dist = HUGE_VAL;
+	for (const CornerDistance &corner: corner_distances) {
+		auto node = nodes.find(corner.conn);
+		if (node == nodes.end())
+			continue;
+		TreeEntry &e = entries[node->second];
+		if (e.dist + corner.d < best_dist) {
+			best_dist = e.dist + corner.d;
+			final_entry = &e;
+		}
+	}
+	if (!final_entry)
+		return false;
+
+	lines.push_back(root_pos);
+	size_t first = lines.size();
+	for (const TreeEntry *act = final_entry; act; act = act->parent)
+		lines.push_back(act->pos);
+	std::reverse(lines.begin() + first, lines.end());
+	lines.push_back(pos);
+	return true;
 }
 
 double PathFinder::heuristics(const QPointF &pos) const
 {
+	if (tree_mode)
+		return 0.0;
+
 	QPointF diff = pos - target_pos;
 	return sqrt(diff.x()*diff.x() + diff.y()*diff.y());
 }
@@ -250,6 +336,7 @@ void PathFinder::iterate()
 		}
 		open_list.pop();
 		e->closed = true;
+		++num_expanded;
 		expand(&*e, e->conn, e->conn.op->get_view_list(e->conn.type));
 	}
 	// Ugh, we did not find a path, leave final_entry as nullptr.
@@ -262,43 +349,69 @@ void PathFinder::expand(const TreeEntry *parent, const ConnectorDesc &from, cons
 		ConnectorDesc child = it->get_other(from, pos);
 
 		// Use connections to connectors only if they are the target
-		if (!child.type.is_corner() && child != target)
+		if (!child.type.is_corner() && (tree_mode || child != target))
 			continue;
 
 		double new_dist = parent ? parent->dist : 0.0;
 		new_dist += it->get_dist();
 
 		// Try to find this node
-		auto it2 = std::find_if(entries.begin(), entries.end(), [&child](const TreeEntry &e)
-									{return e.conn == child;});
-		if (it2 == entries.end()) {
+		auto node = nodes.find(child);
+		if (node == nodes.end()) {
 			add_entry(parent, &*it, child, pos, new_dist, new_dist+heuristics(pos));
 			continue;
 		}
 
 		// Found node. If it is closed, we made a cycle and give up with this path
-		if (it2->closed)
+		TreeEntry &entry = entries[node->second];
+		if (entry.closed)
 			continue;
 
-		// We have to search this entry in the open list
-		IndirectTreeEntry e(&*it2);
-		auto it3 = std::find(open_list.begin(), open_list.end(), e);
-		assert(it3 != open_list.end());
-		if ((*it3)->dist <= new_dist)
+		if (entry.dist <= new_dist)
 			continue;
 
 		// We found a shorter way to this entry -> update accordingly
-		auto handle = heap_t::s_handle_from_iterator(it3);
-		double diff = (*handle)->dist - new_dist;
-		assert(diff > 0.0);
-		(*handle)->parent = parent;
-		(*handle)->view_connection = &*it;
-		(*handle)->dist = new_dist;
-		(*handle)->estimate -= diff;
-		open_list.decrease(handle);
+		double diff = entry.dist - new_dist;
+		entry.parent = parent;
+		entry.view_connection = &*it;
+		entry.dist = new_dist;
+		entry.estimate -= diff;
+		open_list.update(entry.handle);
 	}
 }
 
+size_t PathFinder::get_num_expanded() const
+{
+	return num_expanded;
+}
+
+size_t PathFinder::get_num_visited() const
+{
+	return entries.size();
+}
+
+std::chrono::steady_clock::duration PathFinder::get_time() const
+{
+	return time;
+}
+
+// In debug mode, print statistics of path searches, so that routing can be compared on large canvases.
+static void report_routing(const char *what, size_t num_searches, size_t num_expanded, size_t num_visited,
+			   std::chrono::steady_clock::duration time)
+{
+	if (!Globals::debug_mode)
+		return;
+	double ms = std::chrono::duration<double, std::milli>(time).count();
+	std::cerr << "Routing (" << what << "): " << num_searches << " searches, "
+		  << num_expanded << " nodes expanded, " << num_visited << " nodes visited, "
+		  << ms << " ms" << std::endl;
+}
+
+static void report_routing(const char *what, const PathFinder &path_finder)
+{
+	report_routing(what, 1, path_finder.get_num_expanded(), path_finder.get_num_visited(), path_finder.get_time());
+}
+
 void PathFinder::to_lines(std::vector<QPointF> &lines) const
 {
 	for (const TreeEntry *act = final_entry; act; act = act->parent)
@@ -468,6 +581,7 @@ void Edge::calculate(const QPointF &pos_)
 		path_finder->to_lines(lines);
 		lines.push_back(connector_to->line_from());
 	}
+	report_routing("add edge", *path_finder);
 	render_lines(lines);
 }
 
@@ -484,7 +598,7 @@ void Edge::recalculate_move(bool from_input)
 	QPointF target_pos = conn1->get_safety_pos();
 	QPointF first_point = conn1->line_from();
 	QPointF second_point = conn1->op()->go_out_of_safety_rect(first_point);
-	path_finder = std::make_unique<PathFinder>(conn1, target_pos, document.operator_list);
+	path_finder.reset();
 
 	std::vector<QPointF> lines;
 	lines.reserve(10);		// We need at least 3
@@ -508,25 +622,32 @@ void Edge::recalculate_move(bool from_input)
 		lines.push_back(second_point);
 		lines.push_back(pos);
 	} else {
+		// While moving, the visibility graph doesn't change. Therefore, we
+		// calculate the shortest paths from the fixed end only once.
+		if (!move_tree || move_tree_from_input != from_input) {
+			move_tree = std::make_unique<PathFinder>(conn1, target_pos, document.operator_list);
+			move_tree->calculate_tree(conn1->connector_desc(), target_pos);
+			move_tree_from_input = from_input;
+			report_routing("move", *move_tree);
+		}
 		std::vector<CornerDistance> corner_distances;
 		corner_distances = document.operator_list.get_visible_corners(pos);
-		path_finder->calculate(corner_distances, pos);
-		path_finder->to_lines(lines);
+		if (move_tree->route_from_tree(corner_distances, pos, lines))
+			move_tree->register_view_connections(this);
+		else
+			lines.push_back(pos);
 	}
 	lines.push_back(conn2->line_from());
 	render_lines(lines);
-
-	path_finder->register_view_connections(this);
 }
 
-void Edge::recalculate()
+// Doesn't access the scene, therefore this can be run in parallel for different edges.
+// The start and end points of the lines have to be passed in.
+std::vector<QPointF> Edge::find_path(const QPointF &first_point, const QPointF &last_point)
 {
-	unregister_view_connections();
-
 	std::vector<QPointF> lines;
 	lines.reserve(10);		// We need at least 3
 
-	QPointF first_point = connector_from->line_from();
 	lines.push_back(first_point);
 
 	QPointF pos_to = connector_to->get_safety_pos();
@@ -535,13 +656,52 @@ void Edge::recalculate()
 	path_finder = std::make_unique<PathFinder>(connector_from, target_pos, document.operator_list);
 	path_finder->calculate(connector_to->connector_desc(), pos_to);
 	path_finder->to_lines(lines);
-	lines.push_back(connector_to->line_from());
+	lines.push_back(last_point);
+
+	return lines;
+}
+
+void Edge::recalculate()
+{
+	// This is called when the visibility graph changed. Any path tree calculated while moving is outdated.
+	move_tree.reset();
+	unregister_view_connections();
+
+	std::vector<QPointF> lines = find_path(connector_from->line_from(), connector_to->line_from());
+	report_routing("recalculate", *path_finder);
 
 	render_lines(lines);
 
 	path_finder->register_view_connections(this);
 }
 
+void Edge::recalculate(const std::vector<Edge *> &edges)
+{
+	std::vector<std::pair<QPointF, QPointF>> end_points;
+	end_points.reserve(edges.size());
+	for (Edge *e: edges) {
+		e->unregister_view_connections();
+		end_points.emplace_back(e->connector_from->line_from(), e->connector_to->line_from());
+	}
+
+	std::vector<std::vector<QPointF>> lines(edges.size());
+	parallel_for(edges.size(), [&edges, &end_points, &lines](size_t i) {
+		lines[i] = edges[i]->find_path(end_points[i].first, end_points[i].second);
+	});
+
+	size_t num_expanded = 0, num_visited = 0;
+	std::chrono::steady_clock::duration time(0);
+	for (size_t i = 0; i < edges.size(); ++i) {
+		const PathFinder &path_finder = *edges[i]->path_finder;
+		num_expanded += path_finder.get_num_expanded();
+		num_visited += path_finder.get_num_visited();
+		time += path_finder.get_time();
+		edges[i]->render_lines(lines[i]);
+		path_finder.register_view_connections(edges[i]);
+	}
+	report_routing("bulk", edges.size(), num_expanded, num_visited, time);
+}
+
 void Edge::set_complex(bool comp_)
 {
 	comp = comp_;
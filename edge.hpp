@@ -10,6 +10,7 @@
 #include "edge_cycle.hpp"
 
 #include <memory>
+#include <vector>
 
 #include <QGraphicsPathItem>
 #include <QPainterPath>
@@ -35,6 +36,11 @@ class Edge : public QGraphicsPathItem
 	// the edge on the scene
 	std::unique_ptr<PathFinder> path_finder;
 
+	// While an operator is moved, the shortest paths from the fixed end of the edge
+	// to all corners are kept. move_tree_from_input says which end is fixed.
+	std::unique_ptr<PathFinder> move_tree;
+	bool move_tree_from_input;
+
 	// Is the data transported over this edge complex?
 	bool comp;
 
@@ -58,6 +64,7 @@ class Edge : public QGraphicsPathItem
 	std::vector<ViewConnection *> view_connections;
 
 	void check_connector_to(Connector *to);
+	std::vector<QPointF> find_path(const QPointF &first_point, const QPointF &last_point);
 	void render_lines(const std::vector<QPointF> &lines);
 
 	void unwarn_cycle();
@@ -110,6 +117,9 @@ public:
 	// Recalculate path, if old path was obstructed (or freed)
 	void recalculate();
 
+	// Recalculate the paths of many edges. The paths are searched in parallel.
+	static void recalculate(const std::vector<Edge *> &edges);
+
 	// Recalculate path when moving operator
 	void recalculate_move(bool from_input);
 
@@ -5,11 +5,13 @@
 
 #include <cassert>
 #include <cstring>
+#include <type_traits>
 
 FFTBuf::FFTBuf()
 	: comp(false)
 	, size(0)
 	, forwarded_buf(nullptr)
+	, symmetry(Symmetry::none)
 {
 }
 
@@ -17,6 +19,7 @@ FFTBuf::FFTBuf(bool comp_, size_t size_)
 	: comp(comp_)
 	, size(size_)
 	, forwarded_buf(nullptr)
+	, symmetry(Symmetry::none)
 {
 	size_t n = size * size;
 	if (comp)
@@ -29,6 +32,7 @@ FFTBuf::FFTBuf(FFTBuf &buf)
 	: comp(buf.comp)
 	, forwarded_buf(&buf)
 	, extremes(buf.extremes)
+	, symmetry(Symmetry::none)
 {
 }
 
@@ -39,10 +43,12 @@ FFTBuf::FFTBuf(FFTBuf &&buf)
 	, real_data(std::move(buf.real_data))
 	, complex_data(std::move(buf.complex_data))
 	, extremes(buf.extremes)
+	, symmetry(buf.symmetry)
 {
 	buf.comp = false;
 	buf.forwarded_buf = nullptr;
 	buf.extremes = Extremes();
+	buf.symmetry = Symmetry::none;
 }
 
 FFTBuf &FFTBuf::operator=(FFTBuf &&buf)
@@ -51,12 +57,14 @@ FFTBuf &FFTBuf::operator=(FFTBuf &&buf)
 	size = buf.size;
 	forwarded_buf = buf.forwarded_buf;
 	extremes = buf.extremes;
+	symmetry = buf.symmetry;
 	real_data = std::move(buf.real_data);
 	complex_data = std::move(buf.complex_data);
 
 	buf.comp = false;
 	buf.forwarded_buf = nullptr;
 	buf.extremes = Extremes();
+	buf.symmetry = Symmetry::none;
 	return *this;
 }
 
@@ -101,7 +109,7 @@ std::complex<double> *FFTBuf::get_complex_data()
 {
 	if (forwarded_buf)
 		return forwarded_buf->get_complex_data();
-	assert(complex_data);
+	assert(complex_data && !tile_data);
 	return complex_data.get();
 }
 
@@ -109,10 +117,41 @@ double *FFTBuf::get_real_data()
 {
 	if (forwarded_buf)
 		return forwarded_buf->get_real_data();
-	assert(real_data);
+	assert(real_data && !tile_data);
 	return real_data.get();
 }
 
+std::complex<double> *FFTBuf::get_complex_range(size_t begin)
+{
+	if (forwarded_buf)
+		return forwarded_buf->get_complex_range(begin);
+	assert(complex_data);
+	if (tile_data) {
+		assert(begin >= tile_begin);
+		return static_cast<std::complex<double> *>(tile_data) + (begin - tile_begin);
+	}
+	return complex_data.get() + begin;
+}
+
+double *FFTBuf::get_real_range(size_t begin)
+{
+	if (forwarded_buf)
+		return forwarded_buf->get_real_range(begin);
+	assert(real_data);
+	if (tile_data) {
+		assert(begin >= tile_begin);
+		return static_cast<double *>(tile_data) + (begin - tile_begin);
+	}
+	return real_data.get() + begin;
+}
+
+void FFTBuf::set_tile(void *data, size_t begin)
+{
+	assert(!forwarded_buf);
+	tile_data = data;
+	tile_begin = begin;
+}
+
 const Extremes &FFTBuf::get_extremes() const
 {
 	if (forwarded_buf)
@@ -134,6 +173,59 @@ void FFTBuf::set_extremes(const Extremes &extremes_)
 	extremes = extremes_;
 }
 
+Symmetry FFTBuf::get_symmetry() const
+{
+	if (forwarded_buf)
+		return forwarded_buf->get_symmetry();
+	return symmetry;
+}
+
+bool FFTBuf::set_symmetry(Symmetry symmetry_)
+{
+	if (forwarded_buf)
+		return forwarded_buf->set_symmetry(symmetry_);
+
+	// For real data, hermitian is centrosymmetric
+	if (real_data && (symmetry_ & (Symmetry::hermitian | Symmetry::centrosymmetric)) != Symmetry::none)
+		symmetry_ = symmetry_ | Symmetry::hermitian | Symmetry::centrosymmetric;
+	if (symmetry == symmetry_)
+		return false;
+	symmetry = symmetry_;
+	return true;
+}
+
+template <typename T>
+static Symmetry find_symmetry_doit(const T *data, size_t n)
+{
+	size_t mask = n - 1;
+	bool hermitian = true, centrosymmetric = true, mirror = true;
+	for (size_t y = 0; y < n && (hermitian || centrosymmetric || mirror); ++y) {
+		const T *line = data + y * n;
+		const T *neg_line = data + ((n - y) & mask) * n;
+		for (size_t x = 0; x < n; ++x) {
+			T v = line[x];
+			T neg = neg_line[(n - x) & mask];
+			centrosymmetric &= neg == v;
+			if constexpr (std::is_same_v<T, double>)
+				hermitian &= neg == v;
+			else
+				hermitian &= neg == std::conj(v);
+			mirror &= line[(n - x) & mask] == v && neg_line[x] == v;
+		}
+	}
+	return (hermitian ? Symmetry::hermitian : Symmetry::none) |
+	       (centrosymmetric ? Symmetry::centrosymmetric : Symmetry::none) |
+	       (mirror ? Symmetry::mirror : Symmetry::none);
+}
+
+Symmetry FFTBuf::find_symmetry()
+{
+	if (is_empty())
+		return Symmetry::none;
+	return is_complex() ? find_symmetry_doit(get_complex_data(), get_size())
+			    : find_symmetry_doit(get_real_data(), get_size());
+}
+
 void FFTBuf::clear_data()
 {
 	if (forwarded_buf) {
@@ -5,6 +5,7 @@
 // Buffer can be forwarded (managed by another buffer)
 // to avoid unmodifying copies
 // Buffer can be empty
+// Buffer can hold a single tile of its data (see set_tile())
 
 #ifndef FFT_BUF_HPP
 #define FFT_BUF_HPP
@@ -15,6 +16,32 @@
 #include <complex>
 #include <memory>
 
+// Symmetries of the data, which allow for cheaper transforms.
+// Indices are cyclic, i.e. -j means n - j. For real data,
+// hermitian and centrosymmetric are equivalent.
+enum class Symmetry : unsigned {
+	none = 0,
+	hermitian = 1,		// x[-j] = conj(x[j]), i.e. the FT is real
+	centrosymmetric = 2,	// x[-j] = x[j]
+	mirror = 4,		// x[-j1, j2] = x[j1, -j2] = x[j1, j2]
+};
+
+inline Symmetry operator|(Symmetry s1, Symmetry s2)
+{
+	return static_cast<Symmetry>(static_cast<unsigned>(s1) | static_cast<unsigned>(s2));
+}
+
+inline Symmetry operator&(Symmetry s1, Symmetry s2)
+{
+	return static_cast<Symmetry>(static_cast<unsigned>(s1) & static_cast<unsigned>(s2));
+}
+
+// True if s has all symmetries in flags
+inline bool has_symmetry(Symmetry s, Symmetry flags)
+{
+	return (s & flags) == flags;
+}
+
 class FFTBuf {
 	bool comp;		// Is complex
 	size_t size;		// Size
@@ -23,6 +50,9 @@ class FFTBuf {
 	AlignedBuf<double> real_data;			// If non-forwarded real buffer
 	AlignedBuf<std::complex<double>> complex_data;	// If non-forwarded complex buffer
 	Extremes extremes;
+	Symmetry symmetry;
+	void *tile_data = nullptr;	// In tile mode: data of the current tile
+	size_t tile_begin = 0;		// In tile mode: index of the first element of the tile
 protected:
 	class SaveState {
 		friend FFTBuf;
@@ -48,6 +78,19 @@ public:
 	template <typename T>
 	T* get_data();
 
+	// Pointer to the element at index begin. In contrast to get_data() + begin,
+	// this also works in tile mode.
+	std::complex<double> *get_complex_range(size_t begin);
+	double *get_real_range(size_t begin);
+	template <typename T>
+	T* get_range_data(size_t begin);
+
+	// Tile mode: the data of the elements starting at begin is stored in the
+	// external buffer data, the rest of the data is undefined. Only the
+	// range functions may be used. Used for intermediate results of pointwise
+	// chains, which are consumed tile-by-tile. Pass nullptr to leave tile mode.
+	void set_tile(void *data, size_t begin);
+
 	void clear();			// Set buffer to zero
 	void clear_data();		// Set buffer to zero, but keep extremes
 
@@ -56,6 +99,13 @@ public:
 	double get_max_norm() const;
 	void set_extremes(const Extremes &);
 
+	// Symmetries are set by the operators that produce the data and are treated like the
+	// type of the buffer: operators adapt their output when the input symmetry changes.
+	// find_symmetry() checks the data, set_symmetry() returns true if the symmetry changed.
+	Symmetry get_symmetry() const;
+	bool set_symmetry(Symmetry);
+	Symmetry find_symmetry();
+
 	// Save and restore buffer (because fftw overwrites buffers)
 	SaveState save() const;
 	void restore(const SaveState &);
@@ -73,4 +123,16 @@ inline std::complex<double> *FFTBuf::get_data<std::complex<double>>()
 	return get_complex_data();
 }
 
+template <>
+inline double *FFTBuf::get_range_data<double>(size_t begin)
+{
+	return get_real_range(begin);
+}
+
+template <>
+inline std::complex<double> *FFTBuf::get_range_data<std::complex<double>>(size_t begin)
+{
+	return get_complex_range(begin);
+}
+
 #endif
@@ -4,6 +4,7 @@
 #include "fft_complete.hpp"
 
 #include <fftw3.h>
+#include <algorithm>
 #include <cassert>
 
 FFTPlan::FFTPlan(FFTBuf &in_, FFTBuf &out_, bool forward_, bool norm_)
@@ -12,20 +13,58 @@ FFTPlan::FFTPlan(FFTBuf &in_, FFTBuf &out_, bool forward_, bool norm_)
 	, forward(forward_)
 	, norm(norm_)
 	, in_is_complex(in.is_complex())
+	, real_output(get_real_output(in, out, norm))
 {
 	assert((norm && out.is_real()) ||
-	       (!norm && out.is_complex()));
+	       (!norm && out.is_complex()) ||
+	       real_output != RealOutput::none);
 
 	size_t n = in.get_size();
 	assert(n == out.get_size());
 
+	if (in.is_empty()) {
+		plan = nullptr;
+		return;
+	}
+
+	switch (real_output) {
+	case RealOutput::hartley: {
+		auto save = in.save();
+		plan = fftw_plan_r2r_2d(n, n, in.get_real_data(), out.get_real_data(),
+					FFTW_DHT, FFTW_DHT, FFTW_MEASURE);
+		in.restore(save);
+		return;
+	}
+	case RealOutput::cosine: {
+		// Transform the first n/2 + 1 elements of the first n/2 + 1 rows in place of the
+		// output buffer. The rest is given by the mirror symmetry.
+		int m = static_cast<int>(n / 2 + 1);
+		int sizes[2] = { m, m };
+		int embed[2] = { static_cast<int>(n), static_cast<int>(n) };
+		fftw_r2r_kind kinds[2] = { FFTW_REDFT00, FFTW_REDFT00 };
+		auto save = in.save();
+		plan = fftw_plan_many_r2r(2, sizes, 1, in.get_real_data(), embed, 1, 0,
+					  out.get_real_data(), embed, 1, 0, kinds, FFTW_MEASURE);
+		in.restore(save);
+		return;
+	}
+	case RealOutput::complex_to_real:
+		// The complex-to-real transform destroys its input, therefore the
+		// non-redundant half of the input is copied into mid.
+		mid = AlignedBuf<std::complex<double>>(n * (n / 2 + 1));
+		plan = fftw_plan_dft_c2r_2d(n, n, reinterpret_cast<fftw_complex*>(mid.get()),
+					    out.get_real_data(), FFTW_MEASURE);
+		return;
+	case RealOutput::none:
+	default:
+		break;
+	}
+
 	if (norm) {
 		mid = AlignedBuf<std::complex<double>>(in_is_complex ? n * n : n * (n / 2 + 1));
 	}
 
-	if (in.is_empty()) {
-		plan = nullptr;
-	} else if (in_is_complex) {
+	if (in_is_complex) {
 		auto save = in.save();
 		auto out_buf = reinterpret_cast<fftw_complex*>(
 			norm ? mid.get() : out.get_complex_data()
@@ -44,6 +83,18 @@ FFTPlan::FFTPlan(FFTBuf &in_, FFTBuf &out_, bool forward_, bool norm_)
 	}
 }
 
+// The output is real if the input is hermitian, i.e. real and centrosymmetric or
+// complex and hermitian.
+FFTPlan::RealOutput FFTPlan::get_real_output(const FFTBuf &in, const FFTBuf &out, bool norm)
+{
+	if (norm || in.is_empty() || out.is_complex() || !has_symmetry(in.get_symmetry(), Symmetry::hermitian))
+		return RealOutput::none;
+	if (in.is_complex())
+		return RealOutput::complex_to_real;
+	return has_symmetry(in.get_symmetry(), Symmetry::mirror) ?
+		RealOutput::cosine : RealOutput::hartley;
+}
+
 FFTPlan::~FFTPlan()
 {
 	fftw_destroy_plan(static_cast<fftw_plan>(plan));
@@ -56,6 +107,9 @@ void FFTPlan::execute()
 		return;
 	}
 
+	if (real_output != RealOutput::none)
+		return execute_real_output();
+
 	fftw_execute(static_cast<fftw_plan>(plan));
 
 	// Renormalize and calculate maximum, respectively complete for real data
@@ -97,3 +151,50 @@ void FFTPlan::execute()
 	}
 	out.set_extremes(minmax);
 }
+
+void FFTPlan::execute_real_output()
+{
+	size_t n = in.get_size();
+	double *data = out.get_real_data();
+
+	if (real_output == RealOutput::complex_to_real) {
+		// The transform in FFTW's backward direction corresponds to the forward transform.
+		// The inverse transform of real data is the forward transform of the conjugate.
+		const std::complex<double> *from = in.get_complex_data();
+		std::complex<double> *to = mid.get();
+		for (size_t y = 0; y < n; ++y) {
+			for (size_t x = 0; x < n / 2 + 1; ++x)
+				*to++ = forward ? from[x] : std::conj(from[x]);
+			from += n;
+		}
+	}
+
+	fftw_execute(static_cast<fftw_plan>(plan));
+
+	if (real_output == RealOutput::hartley) {
+		// For centrosymmetric data, the FT at (k1, k2) is the separable
+		// Hartley transform at (k1, -k2).
+		for (size_t y = 0; y < n; ++y) {
+			double *line = data + y * n;
+			for (size_t x = 1; x < n / 2; ++x)
+				std::swap(line[x], line[n - x]);
+		}
+	} else if (real_output == RealOutput::cosine) {
+		// Complete the quadrant using the mirror symmetry
+		for (size_t y = 0; y < n / 2 + 1; ++y) {
+			double *line = data + y * n;
+			for (size_t x = 1; x < n / 2; ++x)
+				line[n - x] = line[x];
+		}
+		for (size_t y = 1; y < n / 2; ++y)
+			std::copy(data + y * n, data + (y + 1) * n, data + (n - y) * n);
+	}
+
+	Extremes minmax;
+	double factor = 1.0 / static_cast<double>(n);
+	for (size_t i = 0; i < n * n; ++i) {
+		// Note that *data is multiplied by factor
+		minmax.reg(*data++, factor);
+	}
+	out.set_extremes(minmax);
+}
@@ -8,6 +8,12 @@
 //
 // This gives quite a lot of combinations which makes the code quite intricate.
 // It might be better to split this into different classes.
+//
+// If the input is hermitian (see FFTBuf::get_symmetry()), the transform is real
+// and the output buffer may be real: real centrosymmetric input is transformed
+// by a Hartley transform, real mirror symmetric input by a cosine transform of
+// one quarter of the data and complex hermitian input by a complex-to-real transform
+// of one half of the data.
 
 #ifndef FFT_PLAN_HPP
 #define FFT_PLAN_HPP
@@ -29,6 +35,16 @@ class FFTPlan {
 	const bool forward;				// Forward or backward transform.
 	const bool norm;				// Calculate norm of complex.
 	const bool in_is_complex;
+
+	enum class RealOutput {
+		none,
+		hartley,
+		cosine,
+		complex_to_real
+	};
+	const RealOutput real_output;
+	static RealOutput get_real_output(const FFTBuf &in, const FFTBuf &out, bool norm);
+	void execute_real_output();
 public:
 	FFTPlan(FFTBuf &in, FFTBuf &out, bool forward, bool norm);
 	~FFTPlan();
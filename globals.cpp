@@ -92,3 +92,15 @@ void Globals::set_last_save_image(const QString &s)
 	QSettings settings;
 	settings.setValue("last_save_image", s);
 }
+
+bool Globals::get_embed_results()
+{
+	QSettings settings;
+	return settings.value("embed_results", false).toBool();
+}
+
+void Globals::set_embed_results(bool embed)
+{
+	QSettings settings;
+	settings.setValue("embed_results", embed);
+}
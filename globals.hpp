@@ -22,6 +22,10 @@ public:
 	static void set_last_save_image(const QString &);
 
 	static QStringList get_recent_files();
+
+	// Store rendered images of views in saved documents
+	static bool get_embed_results();
+	static void set_embed_results(bool);
 };
 
 #endif
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "image_delta.hpp"
+
+#include <QDataStream>
+
+#include <algorithm>
+#include <cassert>
+
+// Tiles of drawings are mostly uniform. Therefore, even the
+// fastest compression level gives a good compression ratio.
+static constexpr int compression_level = 1;
+
+QByteArray ImageDelta::read_tile(const QImage &image, int tile_x, int tile_y)
+{
+	int x = tile_x * tile_size;
+	int y = tile_y * tile_size;
+	int width = std::min(tile_size, image.width() - x);
+	int height = std::min(tile_size, image.height() - y);
+
+	QByteArray data(width * height, Qt::Uninitialized);
+	char *out = data.data();
+	for (int row = y; row < y + height; ++row) {
+		const uchar *in = image.constScanLine(row) + x;
+		std::copy(in, in + width, out);
+		out += width;
+	}
+	return qCompress(data, compression_level);
+}
+
+void ImageDelta::write_tile(QImage &image, int tile_x, int tile_y, const QByteArray &compressed)
+{
+	int x = tile_x * tile_size;
+	int y = tile_y * tile_size;
+	int width = std::min(tile_size, image.width() - x);
+	int height = std::min(tile_size, image.height() - y);
+
+	QByteArray data = qUncompress(compressed);
+	assert(data.size() == width * height);
+	const char *in = data.constData();
+	for (int row = y; row < y + height; ++row) {
+		std::copy(in, in + width, image.scanLine(row) + x);
+		in += width;
+	}
+}
+
+void ImageDelta::save(const QImage &image, QRect rect)
+{
+	assert(image.format() == QImage::Format_Grayscale8);
+	rect &= image.rect();
+	if (rect.isEmpty())
+		return;
+
+	for (int tile_y = rect.top() / tile_size; tile_y <= rect.bottom() / tile_size; ++tile_y) {
+		for (int tile_x = rect.left() / tile_size; tile_x <= rect.right() / tile_size; ++tile_x) {
+			auto [it, inserted] = tiles.try_emplace({ tile_x, tile_y });
+			if (inserted)
+				it->second = read_tile(image, tile_x, tile_y);
+		}
+	}
+}
+
+void ImageDelta::merge(const ImageDelta &other)
+{
+	// try_emplace() keeps the older tiles. QByteArray is implicitly shared, so this doesn't copy data.
+	for (auto &[pos, data]: other.tiles)
+		tiles.try_emplace(pos, data);
+}
+
+void ImageDelta::swap(QImage &image)
+{
+	for (auto &[pos, data]: tiles) {
+		auto [tile_x, tile_y] = pos;
+		QByteArray old_data = read_tile(image, tile_x, tile_y);
+		write_tile(image, tile_x, tile_y, data);
+		data = std::move(old_data);
+	}
+}
+
+bool ImageDelta::empty() const
+{
+	return tiles.empty();
+}
+
+size_t ImageDelta::memory_usage() const
+{
+	size_t res = 0;
+	for (auto &[pos, data]: tiles)
+		res += data.size();
+	return res;
+}
+
+QByteArray ImageDelta::take_data()
+{
+	QByteArray res;
+	QDataStream stream(&res, QIODevice::WriteOnly);
+	stream << static_cast<quint32>(tiles.size());
+	for (auto &[pos, data]: tiles)
+		stream << pos.first << pos.second << data;
+	tiles.clear();
+	return res;
+}
+
+void ImageDelta::restore_data(const QByteArray &data)
+{
+	QDataStream stream(data);
+	quint32 num;
+	stream >> num;
+	for (quint32 i = 0; i < num; ++i) {
+		int tile_x, tile_y;
+		QByteArray tile;
+		stream >> tile_x >> tile_y >> tile;
+		tiles.emplace(std::pair(tile_x, tile_y), std::move(tile));
+	}
+}
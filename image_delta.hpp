@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+// Undo data for drawing on an image: The image is divided into square tiles.
+// Before a tile is painted on, its old content is saved in compressed form.
+// Undoing and redoing exchanges the saved tiles with the content of the image.
+// Thus, the memory use is proportional to the painted area, not to the image size.
+// Only 8-bit grayscale images are supported.
+
+#ifndef IMAGE_DELTA_HPP
+#define IMAGE_DELTA_HPP
+
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+
+#include <map>
+#include <utility>
+
+class ImageDelta {
+	static constexpr int tile_size = 32;
+
+	// Compressed tiles, indexed by tile column and row
+	std::map<std::pair<int, int>, QByteArray> tiles;
+
+	static QByteArray read_tile(const QImage &image, int tile_x, int tile_y);
+	static void write_tile(QImage &image, int tile_x, int tile_y, const QByteArray &data);
+public:
+	// Save all tiles that overlap rect and that were not yet saved.
+	void save(const QImage &image, QRect rect);
+
+	// Add the tiles of other, that are not yet saved.
+	// Call with the delta of a later drawing operation.
+	void merge(const ImageDelta &other);
+
+	// Exchange the saved tiles with the content of the image.
+	void swap(QImage &image);
+
+	bool empty() const;
+	size_t memory_usage() const;	// In bytes
+
+	// Move the tiles out of and back into the delta. Used by the undo stack to spill data to disk.
+	QByteArray take_data();
+	void restore_data(const QByteArray &data);
+};
+
+#endif
@@ -1,29 +1,112 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "magnifier.hpp"
+#include "operator.hpp"
 #include "scene.hpp"
 
 #include <QPainter>
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
 Magnifier::Magnifier(QWidget *parent)
 	: QLabel(parent)
 	, stamp(total_size, total_size)
+	, sampled(total_size, total_size, QImage::Format_ARGB32_Premultiplied)
+	, columns(total_size)
 {
 	stamp.fill(Qt::transparent);
 	QPainter painter(&stamp);
 	painter.setBrush(Qt::SolidPattern);
 	painter.drawEllipse(0, 0, total_size, total_size);
+	painter.end();
+
+	// Remember the extent of the sphere, so that sampled images can be stamped out without compositing
+	QImage stamp_image = stamp.toImage().convertToFormat(QImage::Format_ARGB32);
+	stamp_spans.resize(total_size);
+	for (size_t y = 0; y < total_size; ++y) {
+		const QRgb *line = reinterpret_cast<const QRgb *>(stamp_image.constScanLine(y));
+		auto inside = [](QRgb p) { return qAlpha(p) != 0; };
+		const QRgb *from = std::find_if(line, line + total_size, inside);
+		const QRgb *to = std::find_if(std::make_reverse_iterator(line + total_size),
+					      std::make_reverse_iterator(from), inside).base();
+		stamp_spans[y] = { static_cast<size_t>(from - line), static_cast<size_t>(to - line) };
+	}
 
 	setAttribute(Qt::WA_TransparentForMouseEvents, true);
 	setFixedSize(QSize(total_size, total_size));
 	setPixmap(QPixmap(total_size, total_size));
 }
 
-void Magnifier::go(Scene *scene, const QPointF &scene_pos)
+bool Magnifier::sample_operator(Scene *scene, const QPointF &scene_pos, double view_scale)
+{
+	Operator *op = nullptr;
+	for (QGraphicsItem *item: scene->items(scene_pos)) {
+		if ((op = dynamic_cast<Operator *>(item)))
+			break;
+	}
+	if (!op)
+		return false;
+
+	QImage image = op->get_display_image();
+	if (image.isNull() || image.size() != op->pixmap().size())
+		return false;
+	bool grayscale = image.format() == QImage::Format_Grayscale8;
+	if (!grayscale && image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32)
+		return false;
+
+	// The magnified area must lie inside the image and must not be covered by other items.
+	// Frames around the operator (e.g. the selection) are drawn outside of the image.
+	double scene_size = size / view_scale;
+	QRectF rect(scene_pos - QPointF(scene_size / 2.0, scene_size / 2.0), QSizeF(scene_size, scene_size));
+	if (!op->mapRectToScene(QRectF(QPointF(), image.size())).contains(rect))
+		return false;
+	QRectF op_rect = op->sceneBoundingRect();
+	for (QGraphicsItem *item: scene->items(rect)) {
+		if (item == op)
+			continue;
+		if (item->parentItem() == op && item->sceneBoundingRect().contains(op_rect))
+			continue;
+		return false;
+	}
+
+	// Nearest neighbor sampling: step is the number of image pixels per magnifier pixel
+	QPointF center = op->mapFromScene(scene_pos);
+	double step = 1.0 / (factor * view_scale);
+	double x0 = center.x() - half_size * step;
+	double y0 = center.y() - half_size * step;
+	int max_x = image.width() - 1;
+	int max_y = image.height() - 1;
+	for (size_t x = 0; x < total_size; ++x)
+		columns[x] = std::clamp(static_cast<int>(floor(x0 + (x + 0.5) * step)), 0, max_x);
+
+	for (size_t y = 0; y < total_size; ++y) {
+		int row = std::clamp(static_cast<int>(floor(y0 + (y + 0.5) * step)), 0, max_y);
+		QRgb *out = reinterpret_cast<QRgb *>(sampled.scanLine(y));
+		auto [from, to] = stamp_spans[y];
+		std::fill(out, out + from, 0);
+		std::fill(out + std::max(from, to), out + total_size, 0);
+		if (grayscale) {
+			const uchar *in = image.constScanLine(row);
+			for (size_t x = from; x < to; ++x) {
+				uchar v = in[columns[x]];
+				out[x] = qRgb(v, v, v);
+			}
+		} else {
+			const QRgb *in = reinterpret_cast<const QRgb *>(image.constScanLine(row));
+			for (size_t x = from; x < to; ++x)
+				out[x] = in[columns[x]] | 0xff000000;
+		}
+	}
+	setPixmap(QPixmap::fromImage(sampled));
+	return true;
+}
+
+void Magnifier::grab_view(Scene *scene, const QPoint &relative_pos)
 {
 	QGraphicsView *view = scene->get_view();
 
 	// Generate zoomed bitmap
-	QPoint relative_pos = view->mapFromScene(scene_pos);
 	QRect unzoomed_rect(relative_pos - QPoint(size / 2, size / 2), QSize(size, size));
 	QPixmap unzoomed = view->grab(unzoomed_rect);
 	QPixmap zoomed = unzoomed.scaled(QSize(total_size, total_size), Qt::IgnoreAspectRatio, Qt::FastTransformation);
@@ -33,11 +116,23 @@ void Magnifier::go(Scene *scene, const QPointF &scene_pos)
 	QPainter painter(&stamped);
 	painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
 	painter.drawPixmap(0, 0, zoomed, 0, 0, total_size, total_size);
+	painter.end();
+	setPixmap(stamped);
+}
+
+void Magnifier::go(Scene *scene, const QPointF &scene_pos)
+{
+	QGraphicsView *view = scene->get_view();
+	QPoint relative_pos = view->mapFromScene(scene_pos);
+
+	// Prefer sampling the operator data, which avoids rendering the scene.
+	double view_scale = view->transform().m11();
+	if (view_scale <= 0.0 || !sample_operator(scene, scene_pos, view_scale))
+		grab_view(scene, relative_pos);
 
 	// Calculate position in parent widget
 	relative_pos -= QPoint(half_size, half_size);
 	QPoint window_pos = view->mapToParent(relative_pos);
-	setPixmap(stamped);
 	move(window_pos);
 	setVisible(true);
 }
@@ -2,9 +2,13 @@
 #ifndef MAGNIFIER_HPP
 #define MAGNIFIER_HPP
 
+#include <QImage>
 #include <QPixmap>
 #include <QLabel>
 
+#include <utility>
+#include <vector>
+
 class Scene;
 class Magnifier : public QLabel {
 	static constexpr size_t	size = 50;
@@ -13,6 +17,18 @@ class Magnifier : public QLabel {
 	static constexpr size_t half_size = total_size / 2;
 
 	QPixmap stamp;
+
+	// For every row of the stamp the first and one-past-last column inside the sphere
+	std::vector<std::pair<size_t, size_t>> stamp_spans;
+
+	// Buffers for sampling operator images. Kept to avoid reallocation on every mouse move.
+	QImage sampled;
+	std::vector<int> columns;
+
+	// Sample the image of the operator under the cursor. Returns false if the
+	// magnified area is not completely covered by an unobstructed operator image.
+	bool sample_operator(Scene *scene, const QPointF &scene_pos, double view_scale);
+	void grab_view(Scene *scene, const QPoint &relative_pos);
 public:
 	Magnifier(QWidget *parent);
 	void go(Scene *scene, const QPointF &scene_pos);
@@ -1,4 +1,5 @@
 // SPDX-License-Identifier: GPL-2.0
+#include "benchmark.hpp"
 #include "globals.hpp"
 #include "mainwindow.hpp"
 
@@ -22,12 +23,15 @@ int main(int argc, char *argv[])
 	args.removeFirst();
 	std::vector<QString> filenames;
 	bool no_options = false;
+	bool benchmark = false;
 	for (const QString &arg: qAsConst(args)) {
 		if (arg.isEmpty())
 			continue;
 		if (!no_options && arg[0] == '-') {
 			if (arg == "-debug")
 				Globals::debug_mode = true;
+			else if (arg == "-benchmark")
+				benchmark = true;
 			else if (arg == "--")
 				no_options = true;
 			else
@@ -37,6 +41,14 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	// In benchmark mode, the remaining arguments are the numbers of operators
+	if (benchmark) {
+		std::vector<int> sizes;
+		for (const QString &arg: filenames)
+			sizes.push_back(arg.toInt());
+		return run_benchmark(std::move(sizes));
+	}
+
 	if (filenames.empty()) {
 		// Open a window with default settings
 		MainWindow *w = new MainWindow(nullptr);
@@ -10,6 +10,7 @@
 #include <QFileInfo>
 #include <QMenuBar>
 #include <QMessageBox>
+#include <QScrollBar>
 #include <QStatusBar>
 #include <QToolBar>
 
@@ -31,6 +32,12 @@ MainWindow::MainWindow(const Document *previous_document)
 	recent_file_menu = file_menu->addMenu("Open recent");
 	add_file_menu_item("document-save", "Save", &MainWindow::save_action, file_menu);
 	add_file_menu_item("document-save-as", "Save as", &MainWindow::save_as, file_menu);
+	QAction *embed_results_action = file_menu->addAction("Embed results on save");
+	embed_results_action->setStatusTip("Store the images of views in the file, so that it opens instantly");
+	embed_results_action->setCheckable(true);
+	embed_results_action->setChecked(Globals::get_embed_results());
+	connect(embed_results_action, &QAction::toggled, [](bool checked) { Globals::set_embed_results(checked); });
+	file_menu->addSeparator();
 	add_file_menu_item("window-close", "Close", &MainWindow::close_action, file_menu);
 	populate_recent_file_menu();
 
@@ -50,6 +57,32 @@ MainWindow::MainWindow(const Document *previous_document)
 	connect(delete_action, &QAction::triggered, [this]() { scene->delete_selection(); });
 	edit_menu->addAction(delete_action);
 
+	// Informational entry, updated whenever the menu is opened
+	edit_menu->addSeparator();
+	QAction *undo_footprint_action = edit_menu->addAction(QString());
+	undo_footprint_action->setEnabled(false);
+	connect(edit_menu, &QMenu::aboutToShow, [this, undo_footprint_action]() {
+		Document::UndoFootprint footprint = document->get_undo_footprint();
+		QString text = QStringLiteral("Undo history: %1 MB in memory, %2 MB on disk")
+			.arg(footprint.memory / (1024.0 * 1024.0), 0, 'f', 1)
+			.arg(footprint.disk / (1024.0 * 1024.0), 0, 'f', 1);
+		if (footprint.compressing > 0)
+			text += QStringLiteral(" (%1 MB being compressed)")
+				.arg(footprint.compressing / (1024.0 * 1024.0), 0, 'f', 1);
+		undo_footprint_action->setText(text);
+	});
+
+	QMenu *view_menu = menuBar()->addMenu("View");
+	QAction *zoom_in_action = view_menu->addAction(QIcon::fromTheme("zoom-in"), "Zoom in");
+	zoom_in_action->setShortcut(QKeySequence::ZoomIn);
+	connect(zoom_in_action, &QAction::triggered, [this]() { scene->zoom(2.0); });
+	QAction *zoom_out_action = view_menu->addAction(QIcon::fromTheme("zoom-out"), "Zoom out");
+	zoom_out_action->setShortcut(QKeySequence::ZoomOut);
+	connect(zoom_out_action, &QAction::triggered, [this]() { scene->zoom(0.5); });
+	QAction *zoom_reset_action = view_menu->addAction(QIcon::fromTheme("zoom-original"), "Original size");
+	zoom_reset_action->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_0));
+	connect(zoom_reset_action, &QAction::triggered, [this]() { scene->set_zoom(1.0); });
+
 	QMenu *add_menu = menuBar()->addMenu("Add");
 	QToolBar *toolbar = addToolBar("Toolbar");
 
@@ -102,6 +135,11 @@ MainWindow::MainWindow(const Document *previous_document)
 
 	view = new QGraphicsView(scene);
 	view->setMouseTracking(true);
+	view->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+	for (QScrollBar *bar: { view->horizontalScrollBar(), view->verticalScrollBar() }) {
+		connect(bar, &QScrollBar::valueChanged, scene, &Scene::update_demand);
+		connect(bar, &QScrollBar::rangeChanged, scene, &Scene::update_demand);
+	}
 	setCentralWidget(view);
 
 	status_bar = new QStatusBar;
@@ -236,6 +274,19 @@ const Scene &MainWindow::get_scene() const
 	return *scene;
 }
 
+void MainWindow::changeEvent(QEvent *event)
+{
+	if (event->type() == QEvent::WindowStateChange)
+		scene->update_demand();
+	QMainWindow::changeEvent(event);
+}
+
+void MainWindow::showEvent(QShowEvent *event)
+{
+	scene->update_demand();
+	QMainWindow::showEvent(event);
+}
+
 void MainWindow::closeEvent(QCloseEvent *event)
 {
 	if (!close())
@@ -61,6 +61,8 @@ class MainWindow : public QMainWindow
 
 	// Events
 	void closeEvent(QCloseEvent *event) override;
+	void changeEvent(QEvent *event) override;	// Recalculate when restored from minimized state
+	void showEvent(QShowEvent *event) override;
 	void keyPressEvent(QKeyEvent *event) override;
 
 	void add_icon(const char *icon, const char *tooltip, const std::function<void(void)> &fun,
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "operator.hpp"
 #include "operator_factory.hpp"
+#include "binary_document.hpp"
 #include "color.hpp"
 #include "command.hpp"
 #include "document.hpp"
@@ -13,17 +14,23 @@
 
 #include <QAction>
 #include <QApplication>
+#include <QDataStream>
 #include <QGraphicsSceneMouseEvent>
 #include <QMenu>
+#include <QPainter>
 #include <QStyle>
 
+#include <algorithm>
 #include <cassert>
 
 Operator::Operator(MainWindow &w_)
 	: QGraphicsPixmapItem()
 	, w(w_)
+	, display_pixmap_key(0)
+	, dirty(false)
 	, topo_id(0)
 	, topo_text(nullptr)
+	, shortcut(false)
 	, button_offset(0)
 	, button_left_boundary(0)
 	, button_right_boundary(0)
@@ -630,11 +637,12 @@ void Operator::update_safety_rect()
 			 safety_distance,  safety_distance);
 }
 
-void Operator::enter_placed_mode()
+void Operator::enter_placed_mode(bool add_to_list)
 {
 	reset_connector_positions();
 
-	get_document().operator_list.add(this, get_scene());
+	if (add_to_list)
+		get_document().operator_list.add(this, get_scene());
 }
 
 Connector *Operator::nearest_connector(const QPointF &pos) const
@@ -804,11 +812,25 @@ size_t Operator::get_topo_id() const
 void Operator::set_topo_id(size_t id)
 {
 	topo_id = id;
+	update_debug_text();
+}
+
+void Operator::set_shortcut(bool shortcut_)
+{
+	if (shortcut == shortcut_)
+		return;
+	shortcut = shortcut_;
+	update_debug_text();
+}
 
-	// For debugging: print id
+void Operator::update_debug_text()
+{
+	// For debugging: print id and whether the operator is shortcut
 	if (Globals::debug_mode) {
 		QString text;
-		text.setNum(id);
+		text.setNum(topo_id);
+		if (shortcut)
+			text += " (elided)";
 		if (topo_text) {
 			topo_text->setText(text);
 		} else {
@@ -827,23 +849,25 @@ bool Operator::make_output_empty(size_t bufid)
 	return true;
 }
 
-bool Operator::make_output_complex(size_t bufid)
+bool Operator::make_output_complex(size_t bufid, Symmetry symmetry)
 {
 	FFTBuf &buf = output_buffers[bufid];
 	if (!buf.is_forwarded() && buf.is_complex())
-		return false;
+		return buf.set_symmetry(symmetry);
 	size_t n = get_document().fft_size;
 	buf = FFTBuf(true, n);
+	buf.set_symmetry(symmetry);
 	return true;
 }
 
-bool Operator::make_output_real(size_t bufid)
+bool Operator::make_output_real(size_t bufid, Symmetry symmetry)
 {
 	FFTBuf &buf = output_buffers[bufid];
 	if (!buf.is_forwarded() && buf.is_real())
-		return false;
+		return buf.set_symmetry(symmetry);
 	size_t n = get_document().fft_size;
 	buf = FFTBuf(false, n);
+	buf.set_symmetry(symmetry);
 	return true;
 }
 
@@ -853,11 +877,43 @@ bool Operator::make_output_forwarded(size_t bufid, FFTBuf &copy)
 	return true;
 }
 
+bool Operator::update_output_symmetry(size_t bufid)
+{
+	FFTBuf &buf = output_buffers[bufid];
+	return buf.set_symmetry(buf.find_symmetry());
+}
+
 void Operator::output_buffer_changed()
 {
 	get_document().topo.update_buffers(this, false);
 }
 
+Operator *Operator::get_input_operator(size_t id)
+{
+	Edge *edge = input_connectors[id]->get_parent_edge();
+	return edge ? edge->get_operator_from() : nullptr;
+}
+
+bool Operator::shortcut_depends_on(const Operator &) const
+{
+	return false;
+}
+
+void Operator::update_shortcuts_of_children()
+{
+	std::vector<Operator *> children;
+	for (Connector *conn: output_connectors) {
+		for (Connector *child: conn->get_children()) {
+			Operator *op = child->op();
+			if (op->shortcut_depends_on(*this) &&
+			    std::find(children.begin(), children.end(), op) == children.end())
+				children.push_back(op);
+		}
+	}
+	for (Operator *op: children)
+		get_document().topo.update_buffers(op, true);
+}
+
 Document &Operator::get_document()
 {
 	return w.get_document();
@@ -998,6 +1054,119 @@ Operator::State::~State()
 {
 }
 
+size_t Operator::State::payload_size() const
+{
+	return 0;
+}
+
+QByteArray Operator::State::take_payload()
+{
+	return QByteArray();
+}
+
+void Operator::State::restore_payload(const QByteArray &)
+{
+}
+
+std::vector<const char *> Operator::State::binary_fields() const
+{
+	return {};
+}
+
+void Operator::State::set_binary_field(const char *, const QByteArray &)
+{
+}
+
+// Forwarded buffers are owned by a different operator.
+static bool is_packable(const FFTBuf &buf)
+{
+	return !buf.is_forwarded() && !buf.is_empty();
+}
+
+static size_t buffer_bytes(const FFTBuf &buf)
+{
+	size_t n = buf.get_size() * buf.get_size();
+	return buf.is_complex() ? n * sizeof(std::complex<double>) : n * sizeof(double);
+}
+
+size_t Operator::undo_payload_size() const
+{
+	size_t res = get_state().payload_size();
+	for (const FFTBuf &buf: output_buffers) {
+		if (is_packable(buf))
+			res += buffer_bytes(buf);
+	}
+	return res;
+}
+
+QByteArray Operator::take_undo_payload()
+{
+	QByteArray res;
+	QDataStream stream(&res, QIODevice::WriteOnly);
+	stream << get_state().take_payload();
+	packed_buffers.assign(output_buffers.size(), std::nullopt);
+	for (size_t i = 0; i < output_buffers.size(); ++i) {
+		FFTBuf &buf = output_buffers[i];
+		bool packable = is_packable(buf);
+		stream << packable;
+		if (!packable)
+			continue;
+		bool comp = buf.is_complex();
+		const char *data = comp ? reinterpret_cast<const char *>(buf.get_complex_data())
+					: reinterpret_cast<const char *>(buf.get_real_data());
+		stream << comp << static_cast<quint64>(buf.get_size()) << buf.get_max_norm()
+		       << static_cast<quint32>(buf.get_symmetry());
+		stream << QByteArray::fromRawData(data, static_cast<qsizetype>(buffer_bytes(buf)));
+		packed_buffers[i] = comp;
+		buf = FFTBuf();
+	}
+	return res;
+}
+
+bool Operator::restore_undo_payload(const QByteArray &payload)
+{
+	QDataStream stream(payload);
+	QByteArray state_payload;
+	stream >> state_payload;
+	get_state().restore_payload(state_payload);
+	bool ok = stream.status() == QDataStream::Ok;
+	size_t n = get_fft_size();
+	for (size_t i = 0; i < packed_buffers.size() && i < output_buffers.size(); ++i) {
+		bool packed = false;
+		stream >> packed;
+		if (!packed_buffers[i]) {
+			ok = ok && !packed;
+			continue;
+		}
+
+		// Always reallocate, so that the operator never writes into an empty buffer
+		FFTBuf &buf = output_buffers[i];
+		bool comp = *packed_buffers[i];
+		buf = FFTBuf(comp, n);
+
+		bool data_comp = false;
+		quint64 size = 0;
+		double max_norm = 0.0;
+		quint32 symmetry = 0;
+		QByteArray data;
+		if (packed)
+			stream >> data_comp >> size >> max_norm >> symmetry >> data;
+		ok = ok && packed && stream.status() == QDataStream::Ok && data_comp == comp && size == n &&
+		     static_cast<size_t>(data.size()) == buffer_bytes(buf);
+		if (!ok) {
+			buf.clear();
+			continue;
+		}
+		char *out = comp ? reinterpret_cast<char *>(buf.get_complex_data())
+				 : reinterpret_cast<char *>(buf.get_real_data());
+		std::copy(data.begin(), data.end(), out);
+		buf.set_extremes(Extremes(max_norm));
+		buf.set_symmetry(static_cast<Symmetry>(symmetry));
+	}
+	packed_buffers.clear();
+	return ok;
+}
+
 std::vector<Operator::InitState> Operator::get_init_states()
 {
 	return {};
@@ -1015,6 +1184,17 @@ void Operator::place_set_state_command(const QString &text, std::unique_ptr<Stat
 	d.place_command<CommandSetState>(d, get_scene(), text, this, std::move(state), merge);
 }
 
+void Operator::place_draw_command(const QString &text, ImageDelta delta, bool merge)
+{
+	Document &d = get_document();
+	d.place_command<CommandDrawImage>(d, get_scene(), text, this, std::move(delta), merge);
+}
+
+void Operator::swap_image_delta(ImageDelta &)
+{
+	assert(false); // Only called by operators that place draw commands
+}
+
 void Operator::save_state()
 {
 	saved_state = get_state().clone();
@@ -1064,7 +1244,80 @@ QJsonObject Operator::to_json() const
 	return res;
 }
 
-Operator *Operator::from_json(MainWindow &w, const QJsonObject &desc)
+QImage Operator::get_result_image() const
+{
+	return QImage();
+}
+
+void Operator::set_result_image(const QImage &)
+{
+}
+
+QImage Operator::get_display_image() const
+{
+	return shows_image() ? display_image : QImage();
+}
+
+void Operator::level_of_detail_changed()
+{
+}
+
+double Operator::get_zoom() const
+{
+	return get_scene().get_zoom();
+}
+
+void Operator::show_image(const QImage &image, const QRect &changed, QSize size)
+{
+	if (size.isEmpty())
+		size = image.size();
+
+	// Only recreate the wrapper and the placeholder if the image was reallocated
+	if (!shows_image() || display_image.constBits() != image.constBits() ||
+	    display_image.size() != image.size() || display_image.format() != image.format() ||
+	    display_image.bytesPerLine() != image.bytesPerLine() || display_size != size) {
+		display_image = QImage(image.constBits(), image.width(), image.height(),
+				       image.bytesPerLine(), image.format());
+		display_size = size;
+		if (pixmap().size() != size || pixmap().cacheKey() != display_pixmap_key) {
+			QPixmap placeholder(size);
+			placeholder.fill(Qt::black);
+			setPixmap(placeholder);
+			display_pixmap_key = pixmap().cacheKey();
+		}
+		update();
+		return;
+	}
+	if (changed.isNull()) {
+		update();
+	} else {
+		double scale_x = static_cast<double>(size.width()) / image.width();
+		double scale_y = static_cast<double>(size.height()) / image.height();
+		QRectF rect(changed.x() * scale_x, changed.y() * scale_y,
+			    changed.width() * scale_x, changed.height() * scale_y);
+		update(rect.translated(offset()));
+	}
+}
+
+bool Operator::shows_image() const
+{
+	return !display_image.isNull() && pixmap().cacheKey() == display_pixmap_key;
+}
+
+void Operator::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+	if (!shows_image()) {
+		QGraphicsPixmapItem::paint(painter, option, widget);
+		return;
+	}
+	if (display_image.size() == display_size)
+		painter->drawImage(offset(), display_image);
+	else
+		painter->drawImage(QRectF(offset(), display_size), display_image);
+}
+
+Operator *Operator::from_json(MainWindow &w, const QJsonObject &desc, bool bulk,
+			       const std::vector<QByteArray> &chunks)
 {
 	// For historical reasons, we still support numeric type-ids as well as strings.
 	QJsonValue id_v = desc["type"];
@@ -1086,8 +1339,13 @@ Operator *Operator::from_json(MainWindow &w, const QJsonObject &desc)
 	op->add_to_scene();
 	op->placed();
 	op->update_safety_rect();
-	op->enter_placed_mode();
-	op->state_from_json(desc["state"].toObject());
+	op->enter_placed_mode(!bulk);
+	QJsonObject state_desc = desc["state"].toObject();
+	op->state_from_json(state_desc);
+	for (const char *field: op->get_state().binary_fields()) {
+		if (std::optional<QByteArray> data = get_chunk(state_desc[field], chunks))
+			op->get_state().set_binary_field(field, *data);
+	}
 	op->state_reset();
 
 	return op.release();
@@ -1182,7 +1440,7 @@ void Operator::readd_to_view_list()
 	recalculate_edges();
 }
 
-void Operator::move_event(QPointF mouse_pos)
+bool Operator::move_event(QPointF mouse_pos)
 {
 	// If this is the first move, remove the operator from the view list
 	if (!move_started) {
@@ -1199,13 +1457,16 @@ void Operator::move_event(QPointF mouse_pos)
 	safety_rect.adjust(-safety_distance, -safety_distance-button_offset-button_height,
 			    safety_distance,  safety_distance);
 	if (w.get_document().operator_list.operator_in_rect(safety_rect))
-		return;
+		return false;
 
 	setPos(move_to);
 	update_safety_rect();
 	reset_connector_positions();
+	return true;
+}
 
-	// Recalculate edges
+void Operator::reroute_moved_edges()
+{
 	for (Connector *conn: input_connectors) {
 		Edge *e = conn->get_parent_edge();
 		if (e)
@@ -1251,10 +1512,112 @@ void Operator::move_to(QPointF pos)
 	readd_to_view_list();
 }
 
-void Operator::execute_topo()
+void Operator::execute_topo(bool include_self)
 {
-	// Only execute children. This is called by an operator that has updated its data.
-	get_document().topo.execute(this, false);
+	// Without include_self, only execute children. This is called by an operator that has updated its data.
+	get_document().topo.execute(this, include_self);
+}
+
+bool Operator::is_on_screen() const
+{
+	return get_scene().is_on_screen(sceneBoundingRect());
+}
+
+bool Operator::has_demand() const
+{
+	// Operators without output show their results
+	return num_output() == 0;
+}
+
+bool Operator::is_dirty() const
+{
+	return dirty;
+}
+
+void Operator::set_dirty(bool dirty_)
+{
+	dirty = dirty_;
+}
+
+// Ids are unique over all operators, so that a child doesn't confuse the outputs of different parents
+uint64_t Operator::next_output_content_id = 1;
+
+const Operator::OutputContent &Operator::get_output_content() const
+{
+	return output_content;
+}
+
+void Operator::set_output_origin(const QPointF &origin, bool new_content)
+{
+	if (new_content || output_content.id == 0)
+		output_content.id = next_output_content_id++;
+	output_content.origin = origin;
+}
+
+bool Operator::has_local_changes() const
+{
+	return false;
+}
+
+bool Operator::is_pointwise() const
+{
+	return false;
+}
+
+void Operator::execute_range(size_t, size_t)
+{
+	assert(false);
+}
+
+void Operator::execute_finish()
+{
+}
+
+void Operator::execute_pointwise()
+{
+	size_t fft_size = get_fft_size();
+	execute_range(0, fft_size * fft_size);
+	execute_finish();
+}
+
+// Number of elements per tile. The tile of a complex buffer takes 64 kB,
+// so that the tiles of short chains still fit into L2 cache.
+static constexpr size_t pointwise_tile_size = 4096;
+
+void Operator::execute_pointwise_chain(const std::vector<Operator *> &chain, const std::vector<bool> &store)
+{
+	if (chain.empty())
+		return;
+	if (chain.size() == 1)
+		return chain[0]->execute();
+
+	// Complex scratch buffers are large enough for real data, too
+	std::vector<FFTBuf *> tiled;
+	std::vector<AlignedBuf<std::complex<double>>> scratch;
+	for (size_t i = 0; i < chain.size(); ++i) {
+		if (store[i])
+			continue;
+		for (FFTBuf &buf: chain[i]->output_buffers) {
+			if (buf.is_forwarded() || buf.is_empty())
+				continue;
+			tiled.push_back(&buf);
+			scratch.emplace_back(pointwise_tile_size);
+		}
+	}
+
+	size_t fft_size = chain[0]->get_fft_size();
+	size_t n = fft_size * fft_size;
+	for (size_t begin = 0; begin < n; begin += pointwise_tile_size) {
+		size_t end = std::min(n, begin + pointwise_tile_size);
+		for (size_t i = 0; i < tiled.size(); ++i)
+			tiled[i]->set_tile(scratch[i].get(), begin);
+		for (Operator *op: chain)
+			op->execute_range(begin, end);
+	}
+	for (FFTBuf *buf: tiled)
+		buf->set_tile(nullptr, 0);
+	for (Operator *op: chain)
+		op->execute_finish();
 }
 
 size_t Operator::get_fft_size() const
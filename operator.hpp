@@ -27,6 +27,7 @@
 #include "handle_interface.hpp"
 
 #include <QGraphicsPixmapItem>
+#include <QImage>
 #include <QGraphicsRectItem>
 #include <QGraphicsSimpleTextItem>
 #include <QSvgRenderer>
@@ -39,8 +40,10 @@
 #include <vector>
 #include <array>
 #include <functional>
+#include <optional>
 
 class Document;
+class ImageDelta;
 class MainWindow;
 class Scene;
 class TopologicalOrder;
@@ -60,6 +63,19 @@ public:
 		virtual std::unique_ptr<State> clone() const = 0;
 		virtual QJsonObject to_json() const = 0;
 		virtual void from_json(const QJsonObject &) = 0;
+
+		// Heavy data (e.g. images), which may be packed by the undo stack.
+		// take_payload() moves the data out of the state, restore_payload() moves it back.
+		virtual size_t payload_size() const;
+		virtual QByteArray take_payload();
+		virtual void restore_payload(const QByteArray &);
+
+		// Fields of the JSON representation that contain base64 encoded binary data.
+		// The binary file format stores them as compressed chunks.
+		// When loading a binary file, the chunks are passed to set_binary_field()
+		// after from_json().
+		virtual std::vector<const char *> binary_fields() const;
+		virtual void set_binary_field(const char *field, const QByteArray &data);
 	};
 
 	// Template using the CRTP pattern to define the State::clone() function:
@@ -80,6 +96,12 @@ public:
 	};
 	static std::vector<InitState> get_init_states();
 
+	// Identifies the outputs up to a translation, see get_output_content().
+	struct OutputContent {
+		uint64_t id = 0;
+		QPointF origin;
+	};
+
 	virtual const State &get_state() const = 0;
 	State &get_state();
 	void place_set_state_command(const QString &text, std::unique_ptr<State> state, bool merge);
@@ -88,7 +110,14 @@ public:
 	virtual void state_from_json(const QJsonObject &) = 0;
 	virtual void state_reset() = 0; // called if state was reset
 
-	void move_event(QPointF mouse_pos); // called by the scene when moving the operator
+	// Lightweight alternative to set state commands for operators that are painted on.
+	// swap_image_delta() exchanges the tiles of the delta with the image and recalculates.
+	void place_draw_command(const QString &text, ImageDelta delta, bool merge);
+	virtual void swap_image_delta(ImageDelta &);
+
+	void enter_move_mode(QPointF mouse_pos); // called on mouse press, registers the operator with the scene
+	bool move_event(QPointF mouse_pos); // called by the scene when moving the operator, returns true if moved
+	void reroute_moved_edges();	// called by the scene after move events, throttled
 	void leave_move_mode(bool commit);
 	void move_to(QPointF pos);
 protected:
@@ -96,6 +125,10 @@ protected:
 private:
 	// Save state while dragging
 	std::unique_ptr<State> saved_state;
+
+	// For each output buffer taken by take_undo_payload(): is it complex?
+	// Used to reallocate the buffers if the payload can't be restored.
+	std::vector<std::optional<bool>> packed_buffers;
 public:
 	// These functions are used when dragging:
 	// - save_state() is called on beginning of draging and saves the current state.
@@ -104,9 +137,19 @@ public:
 	// restore_state() destroys any saved state.
 	// restore_state() and commit_state() have no effect if there is no saved state.
 	// Therefore, it is safe to call commit_state() followed by restore_state(). The second call will be a no-op.
-	void save_state();
-	void restore_state();
-	void commit_state();
+	// Operators that place their own commands while dragging may override these functions.
+	virtual void save_state();
+	virtual void restore_state();
+	virtual void commit_state();
+
+	// Used by the undo stack to pack the data of operators that are not in the scene:
+	// The payload of the state and the output buffers.
+	// restore_undo_payload() returns false if the payload is corrupt (e.g. the spill
+	// file couldn't be read). The buffers are then reallocated and zeroed, and the
+	// caller must call state_reset() once the operator is back in the scene.
+	size_t undo_payload_size() const;
+	QByteArray take_undo_payload();
+	bool restore_undo_payload(const QByteArray &);
 protected:
 	std::vector<Connector *> input_connectors;
 	std::vector<Connector *> output_connectors;
@@ -250,21 +293,47 @@ protected:
 	// Returns true if buffer actually was changed.
 	// Making a forwarded buffer always returns true,
 	// because we don't know if the forwarded buffer changed.
+	// The symmetry of the output is part of its type, see FFTBuf::get_symmetry().
 	bool make_output_empty(size_t bufid);
-	bool make_output_complex(size_t bufid);
-	bool make_output_real(size_t bufid);
+	bool make_output_complex(size_t bufid, Symmetry symmetry = Symmetry::none);
+	bool make_output_real(size_t bufid, Symmetry symmetry = Symmetry::none);
 	bool make_output_forwarded(size_t bufid, FFTBuf &copy);
 
+	// Generators call this after calculating an output buffer. Returns true if the
+	// symmetry of the data changed, in which case output_buffer_changed() must be called.
+	bool update_output_symmetry(size_t bufid);
+
 	// Call this function if the output buffers were changed outside
 	// of a input_connection_changed() chain. Will not, only change
 	// downstream buffers.
 	void output_buffer_changed();
 
+	// Algebraic shortcuts: if the result of an operator is known from its
+	// ancestors (e.g. the inverse FT of a FT), the operator forwards or
+	// copies the buffer of the ancestor instead of calculating.
+	// This is decided in input_connection_changed() and reported with
+	// set_shortcut(). If the decision depends on a parent, the operator
+	// overrides shortcut_depends_on(), so that it is reevaluated even if
+	// the output of the parent did not change. A parent whose state
+	// influences the decision calls update_shortcuts_of_children() when
+	// its state changes.
+	Operator *get_input_operator(size_t id);	// nullptr if not connected
+	void set_shortcut(bool shortcut);
+	void update_shortcuts_of_children();
+
 	// Used for saving.
 	virtual OperatorId get_id() const = 0;
 
-	// Update all child objects in the topological order
-	void execute_topo();
+	// Update all child objects in the topological order.
+	// If include_self is true, this operator is executed as well.
+	// Only operators that are needed by a view on screen are executed, see TopologicalOrder.
+	void execute_topo(bool include_self = false);
+
+	// True if the operator is visible in the view of its window
+	bool is_on_screen() const;
+
+	// Execute a pointwise operator on the whole buffer.
+	void execute_pointwise();
 
 	size_t get_fft_size() const;
 
@@ -275,7 +344,35 @@ protected:
 	// of time compared to the main loop. But it also shouldn't hurt.
 	template <typename operator_t>
 	void dispatch_calculate(operator_t &op);
+
+	// Show an image without converting it to a pixmap: the image is painted directly.
+	// It must not be destroyed or reallocated until show_image() or setPixmap() is called
+	// again. Operators render into the image and call show_image() after every change.
+	// changed is the modified region in image coordinates, a null rect means everything.
+	// If size is given, the image is a reduced level of detail and is scaled to size.
+	void show_image(const QImage &image, const QRect &changed = QRect(), QSize size = QSize());
+
+	// Zoom factor of the view
+	double get_zoom() const;
+
+
+	// Generators call this after every change of their outputs, see get_output_content().
+	// new_content is false if the outputs were only translated to the new origin.
+	void set_output_origin(const QPointF &origin, bool new_content);
 private:
+	// Non-owning wrapper of the image passed to show_image().
+	// The pixmap is a placeholder, which only defines the geometry of the item.
+	// If it was replaced by setPixmap(), the image is not shown anymore.
+	QImage display_image;
+	QSize display_size;
+	qint64 display_pixmap_key;
+
+	bool dirty;
+	OutputContent output_content;
+	static uint64_t next_output_content_id;
+	bool shows_image() const;
+	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
 	// Border around operator.
 	// Is drawn thicker if operator is selected.
 	QGraphicsRectItem *border;
@@ -292,6 +389,10 @@ private:
 	// Place in topological order list.
 	size_t topo_id;
 	QGraphicsSimpleTextItem *topo_text;	// For debugging purposes
+	void update_debug_text();
+
+	// Operator is shortcut, i.e. doesn't calculate its output
+	bool shortcut;
 
 	void add_connectors(std::vector<Connector *> &array, size_t num, bool output);
 	void reset_connector_positions();
@@ -326,7 +427,6 @@ private:
 	Document &get_document();
 	const Document &get_document() const;
 
-	void enter_move_mode(QPointF mouse_pos);
 	bool move_started;
 	QPointF move_start_pos;
 	QPointF move_mouse_start_pos;
@@ -377,7 +477,9 @@ public:
 
 	void prepare_init();
 	void finish_init();
-	void enter_placed_mode();
+	// If add_to_list is false, the caller is responsible for adding
+	// the operator to the operator list (see OperatorList::add_bulk()).
+	void enter_placed_mode(bool add_to_list = true);
 
 	// Locate corners of safety rectangle visible from a point
 	// (ignore itermediate obstacles)
@@ -411,6 +513,27 @@ public:
 	// Execute this operator
 	virtual void execute() = 0;
 
+	// Pointwise operators, i.e. operators where each output element only
+	// depends on the input elements at the same position, can additionally
+	// be executed on ranges of elements. Chains of such operators are
+	// executed tile-by-tile by the topological order, so that the buffers
+	// are still in cache when they are read by the next operator.
+	// begin is a multiple of 64, so that the data in the ranges stays aligned.
+	// After all ranges were processed, execute_finish() is called, which
+	// sets the extremes of the output buffers.
+	virtual bool is_pointwise() const;
+	virtual void execute_range(size_t begin, size_t end);
+	virtual void execute_finish();
+
+	// See set_shortcut()
+	virtual bool shortcut_depends_on(const Operator &parent) const;
+
+	// Execute pointwise operators, given in topological order, tile-by-tile.
+	// The outputs of operators with store[i] == false are only written to a scratch
+	// buffer per tile (see FFTBuf::set_tile()), since they are only read by later
+	// operators of the chain.
+	static void execute_pointwise_chain(const std::vector<Operator *> &chain, const std::vector<bool> &store);
+
 	Connector *nearest_connector(const QPointF &pos) const;
 	const std::vector<ConnectorPos> &get_connector_pos() const;
 	Connector &get_input_connector(size_t id);
@@ -460,7 +583,43 @@ public:
 	QJsonObject to_json() const;
 
 	// Construct an operator from a JSON description.
-	static Operator *from_json(MainWindow &w, const QJsonObject &desc);
+	// If bulk is true, the operator is not added to the operator list.
+	// This is done by the caller, once all operators are loaded.
+	// chunks are the binary fields of a binary document (see binary_document.hpp).
+	static Operator *from_json(MainWindow &w, const QJsonObject &desc, bool bulk = false,
+				   const std::vector<QByteArray> &chunks = {});
+
+	// Displayed results, which can be embedded in saved documents,
+	// so that they can be shown before the document is recalculated.
+	// get_result_image() returns a null image if there is nothing to show.
+	virtual QImage get_result_image() const;
+	virtual void set_result_image(const QImage &);
+
+	// The image shown by the operator at full resolution, i.e. the source of the
+	// pixmap. Used by the magnifier to sample data instead of grabbing the widget.
+	// Returns a null image if the operator only shows an icon.
+	virtual QImage get_display_image() const;
+
+	// Called by the scene when the zoom of the view changed
+	virtual void level_of_detail_changed();
+
+	// Demand driven evaluation: operators are only executed if a result is needed.
+	// has_demand() returns true if the results of the operator are needed, e.g. a
+	// visible view. Dirty operators were not executed since their input changed.
+	virtual bool has_demand() const;
+	bool is_dirty() const;
+	void set_dirty(bool dirty);
+
+	// Generators whose outputs may change by a mere translation (e.g. a moved object)
+	// report this with set_output_origin(). Outputs with the same content id only differ
+	// by a cyclic translation by the difference of their origins (in pixels). Thus,
+	// children can update their results instead of recalculating, see OperatorFFT.
+	// Content id 0 means that the operator doesn't report translations.
+	const OutputContent &get_output_content() const;
+
+	// Operators whose outputs typically change in small regions (e.g. painting) return true.
+	// Children may then keep a copy of their input to update their results incrementally.
+	virtual bool has_local_changes() const;
 
 	// Call this function to select operator
 	void clicked(QGraphicsSceneMouseEvent *event);
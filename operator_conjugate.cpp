@@ -10,38 +10,57 @@ void OperatorConjugate::init()
 bool OperatorConjugate::input_connection_changed()
 {
 	// Empty if the input buffer is empty.
+	set_shortcut(false);
 	if (input_connectors[0]->is_empty_buffer())
 		return make_output_empty(0);
 
 	FFTBuf &buf = input_connectors[0]->get_buffer();
 
 	// For real data, the complex conjugate is the identity function
-	if (buf.is_complex())
-		return make_output_complex(0);
-	else
+	if (!buf.is_complex())
 		return make_output_forwarded(0, input_connectors[0]->get_buffer());
+
+	// The conjugate of a conjugate is the identity function
+	auto parent = dynamic_cast<OperatorConjugate *>(get_input_operator(0));
+	if (parent && !parent->input_connectors[0]->is_empty_buffer()) {
+		set_shortcut(true);
+		return make_output_forwarded(0, parent->input_connectors[0]->get_buffer());
+	}
+
+	// Conjugation preserves all symmetries
+	return make_output_complex(0, buf.get_symmetry());
 }
 
-template<size_t N>
-void OperatorConjugate::calculate()
+bool OperatorConjugate::shortcut_depends_on(const Operator &parent) const
 {
-	FFTBuf &in_buf = input_connectors[0]->get_buffer();
-	FFTBuf &out_buf = output_buffers[0];
+	return dynamic_cast<const OperatorConjugate *>(&parent) != nullptr;
+}
 
-	// Only called for complex buffers
-	auto *in = in_buf.get_data<std::complex<double>>();
-	auto *out = out_buf.get_data<std::complex<double>>();
-	for (size_t i = 0; i < N*N; ++i)
-		*out++ = std::conj(*in++);
+void OperatorConjugate::execute()
+{
+	execute_pointwise();
+}
 
-	out_buf.set_extremes(in_buf.get_extremes());
+bool OperatorConjugate::is_pointwise() const
+{
+	return true;
 }
 
-void OperatorConjugate::execute()
+void OperatorConjugate::execute_range(size_t begin, size_t end)
+{
+	if (output_buffers[0].is_forwarded() || input_connectors[0]->is_empty_buffer())
+		return; // Empty, real or shortcut -> nothing to do
+
+	auto *in = input_connectors[0]->get_buffer().get_complex_range(begin);
+	auto *out = output_buffers[0].get_complex_range(begin);
+	for (size_t i = begin; i < end; ++i)
+		*out++ = std::conj(*in++);
+}
+
+void OperatorConjugate::execute_finish()
 {
-	if (input_connectors[0]->is_empty_buffer() ||
-	    !input_connectors[0]->get_buffer().is_complex())
-		return; // Empty or real -> nothing to do
+	if (output_buffers[0].is_forwarded() || input_connectors[0]->is_empty_buffer())
+		return; // Empty, real or shortcut -> nothing to do
 
-	dispatch_calculate(*this);
+	output_buffers[0].set_extremes(input_connectors[0]->get_buffer().get_extremes());
 }
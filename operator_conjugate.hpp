@@ -8,15 +8,16 @@ class OperatorConjugate : public OperatorNoState<OperatorId::Conjugate, 1, 1>
 {
 	bool input_connection_changed() override;
 	void execute() override;
+	bool is_pointwise() const override;
+	void execute_range(size_t begin, size_t end) override;
+	void execute_finish() override;
+	bool shortcut_depends_on(const Operator &parent) const override;
 public:
 	inline static constexpr const char *icon = ":/icons/conjugate.svg";
 	inline static constexpr const char *tooltip = "Add Conjugate";
 
 	using OperatorNoState::OperatorNoState;
 	void init() override;
-private:
-	friend class Operator;
-	template<size_t N> void calculate();
 };
 
 #endif
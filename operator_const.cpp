@@ -12,6 +12,7 @@ OperatorConst::OperatorConst(MainWindow &w)
 	: OperatorTemplate(w)
 	, imagebuf(size * size)
 	, current_color_type((ColorType)-1)
+	, was_one(true)
 {
 }
 
@@ -63,6 +64,12 @@ void OperatorConst::state_reset()
 {
 	if (current_color_type != state.color_type)
 		paint_image();
+
+	// Children might have to switch between shortcut and calculation
+	if (was_one != is_one()) {
+		was_one = is_one();
+		update_shortcuts_of_children();
+	}
 	calculate();
 	place_handle();
 	set_scroller();
@@ -73,14 +80,18 @@ void OperatorConst::paint_image()
 	current_color_type = state.color_type; // save old color type to avoid useless repainting of the image
 	make_color_wheel(imagebuf, size, scale, state.color_type);
 
-	uint32_t *out = imagebuf.get();
-	QImage image(reinterpret_cast<unsigned char *>(out),
-		     size, size, QImage::Format_RGB32);
-	setPixmap(QPixmap::fromImage(image));
+	show_image(QImage(reinterpret_cast<const unsigned char *>(imagebuf.get()),
+			  size, size, QImage::Format_RGB32));
+}
+
+bool OperatorConst::is_one() const
+{
+	return state.v * state.scale == 1.0;
 }
 
 void OperatorConst::placed()
 {
+	was_one = is_one();
 	make_output_complex(0);
 	calculate();
 	place_handle();
@@ -29,6 +29,7 @@ class OperatorConst : public OperatorTemplate<OperatorId::Const, OperatorConstSt
 	QGraphicsTextItem *text;
 	ColorType current_color_type;
 	bool dont_accumulate_undo;
+	bool was_one;
 
 	void placed() override;
 	void state_reset() override;
@@ -61,6 +62,9 @@ public:
 
 	OperatorConst(MainWindow &w);
 	void init() override;
+
+	// Multiplication by this constant is the identity
+	bool is_one() const;
 };
 
 #endif
@@ -21,13 +21,32 @@ bool OperatorConvolution::input_connection_changed()
 		make_output_complex(0) : make_output_real(0);
 
 	plan = std::make_unique<ConvolutionPlan>(new_buf1, new_buf2, output_buffers[0]);
+	input_content = get_input_content();
 
 	return updated_output;
 }
 
+std::array<uint64_t, 2> OperatorConvolution::get_input_content()
+{
+	std::array<uint64_t, 2> res;
+	for (size_t i = 0; i < 2; ++i) {
+		Operator *parent = get_input_operator(i);
+		res[i] = parent ? parent->get_output_content().id : 0;
+	}
+	return res;
+}
+
 void OperatorConvolution::execute()
 {
 	if (!plan)
 		return;
+	// Most operators don't report their content (id 0), so their structure
+	// may have changed on every execution. The scans of the inputs stop early,
+	// so choosing the method again is cheap compared to the convolution.
+	std::array<uint64_t, 2> content = get_input_content();
+	if (content != input_content || content[0] == 0 || content[1] == 0) {
+		plan->reset_method();
+		input_content = content;
+	}
 	plan->execute();
 }
@@ -5,6 +5,7 @@
 #include "operator.hpp"
 #include "convolution_plan.hpp"
 
+#include <array>
 #include <memory>
 
 class OperatorConvolution : public OperatorNoState<OperatorId::Convolution, 2, 1>
@@ -12,6 +13,11 @@ class OperatorConvolution : public OperatorNoState<OperatorId::Convolution, 2, 1
 	bool input_connection_changed() override;
 	void execute() override;
 	std::unique_ptr<ConvolutionPlan> plan;
+	// Content ids of the inputs (see Operator::get_output_content()) when the
+	// method of the plan was chosen. A new content may have a different structure.
+	// Id 0 means unknown: the method is chosen again on every execution.
+	std::array<uint64_t, 2> input_content { 0, 0 };
+	std::array<uint64_t, 2> get_input_content();
 public:
 	inline static constexpr const char *icon = ":/icons/convolution.svg";
 	inline static constexpr const char *tooltip = "Add Convolution";
@@ -17,6 +17,7 @@
 #include "operator_polygon.hpp"
 #include "operator_split.hpp"
 #include "operator_sum.hpp"
+#include "operator_symmetrize.hpp"
 #include "operator_view.hpp"
 
 OperatorFactory operator_factory;
@@ -63,6 +64,7 @@ OperatorFactory::OperatorFactory()
 	add<OperatorMult>("mult", funcs, descs, names, false);
 	add<OperatorPow>("pow", funcs, descs, names, false);
 	add<OperatorInversion>("inversion", funcs, descs, names, false);
+	add<OperatorSymmetrize>("symmetrize", funcs, descs, names, false);
 	add<OperatorConjugate>("conjugate", funcs, descs, names, false);
 	add<OperatorPowder>("powder", funcs, descs, names, true);
 
@@ -1,6 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "operator_fft.hpp"
 #include "document.hpp"
+#include "aligned_buf.hpp"	// For assume_aligned
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <vector>
 
 QJsonObject OperatorFFTState::to_json() const
 {
@@ -93,8 +99,25 @@ std::vector<Operator::InitState> OperatorFFT::get_init_states()
 	return res;
 }
 
+// Symmetry of the FT of a buffer
+static Symmetry transform_symmetry(FFTBuf &buf)
+{
+	Symmetry symmetry = buf.get_symmetry();
+	Symmetry res = symmetry & (Symmetry::centrosymmetric | Symmetry::mirror);
+
+	// The FT of real data is hermitian
+	if (!buf.is_complex() || has_symmetry(symmetry, Symmetry::hermitian | Symmetry::centrosymmetric))
+		res = res | Symmetry::hermitian;
+	return res;
+}
+
 bool OperatorFFT::update_plan()
 {
+	// The output buffer is (re)calculated from scratch
+	input_content = Operator::OutputContent();
+	input_snapshot.reset();
+	set_shortcut(false);
+	shortcut_source = nullptr;
 	if (input_connectors[0]->is_empty_buffer()) {
 		plan.reset();
 		return make_output_empty(0);
@@ -107,9 +130,27 @@ bool OperatorFFT::update_plan()
 	else if (state.type == OperatorFFTType::NORM)
 		norm = true;
 
+	// If the parent does the opposite transformation, use its input.
+	// Don't create a plan in this case, since that can be expensive.
+	auto parent = dynamic_cast<OperatorFFT *>(get_input_operator(0));
+	if (!norm && parent && !parent->input_connectors[0]->is_empty_buffer() &&
+	    parent->state.type == (forward ? OperatorFFTType::INV : OperatorFFTType::FWD)) {
+		plan.reset();
+		set_shortcut(true);
+		FFTBuf &source = parent->input_connectors[0]->get_buffer();
+		if (source.is_complex())
+			return make_output_forwarded(0, source);
+		shortcut_source = &source;
+		return make_output_complex(0);
+	}
+
+	// The FT of hermitian data is real
 	FFTBuf &new_buf = input_connectors[0]->get_buffer();
+	Symmetry symmetry = transform_symmetry(new_buf);
 	bool updated_output = norm ?
-		make_output_real(0) : make_output_complex(0);
+		make_output_real(0) :
+		has_symmetry(new_buf.get_symmetry(), Symmetry::hermitian) ?
+		make_output_real(0, symmetry) : make_output_complex(0, symmetry);
 
 	plan = std::make_unique<FFTPlan>(new_buf, output_buffers[0], forward, norm);
 	return updated_output;
@@ -120,6 +161,11 @@ bool OperatorFFT::input_connection_changed()
 	return update_plan();
 }
 
+bool OperatorFFT::shortcut_depends_on(const Operator &parent) const
+{
+	return dynamic_cast<const OperatorFFT *>(&parent) != nullptr;
+}
+
 void OperatorFFT::set_type(OperatorFFTType type)
 {
 	if (state.type == type)
@@ -135,15 +181,196 @@ void OperatorFFT::state_reset()
 	setPixmap(get_pixmap(state.type, simple_size));
 	if (update_plan())
 		output_buffer_changed();
-	execute();
+	update_shortcuts_of_children();
+	// Execute this operator and its children, if they are needed
+	execute_topo(true);
+}
+
+void OperatorFFT::copy_shortcut_source()
+{
+	size_t n = get_fft_size() * get_fft_size();
+	const double *in = assume_aligned(shortcut_source->get_real_data());
+	std::complex<double> *out = assume_aligned(output_buffers[0].get_complex_data());
+	Extremes extremes;
+	for (size_t i = 0; i < n; ++i) {
+		std::complex<double> c = in[i];
+		out[i] = extremes.reg(c, 1.0);
+	}
+	output_buffers[0].set_extremes(extremes);
+}
+
+// exp(sign * 2 pi i * shift * k / n) for all frequencies k of a line.
+// Frequencies above n/2 are negative, so that fractional shifts work as well.
+static std::vector<std::complex<double>> phase_ramp(size_t n, double shift, double sign)
+{
+	std::vector<std::complex<double>> res(n);
+	for (size_t k = 0; k < n; ++k) {
+		double freq = k < n / 2 ? static_cast<double>(k) : static_cast<double>(k) - n;
+		res[k] = std::polar(1.0, sign * 2.0 * M_PI * shift * freq / n);
+	}
+	return res;
+}
+
+bool OperatorFFT::apply_translation()
+{
+	Operator *parent = get_input_operator(0);
+	if (!parent || input_content.id == 0 || parent->get_output_content().id != input_content.id)
+		return false;
+	if (!output_buffers[0].is_complex() && state.type != OperatorFFTType::NORM)
+		return false;
+
+	QPointF delta = parent->get_output_content().origin - input_content.origin;
+	if (state.type == OperatorFFTType::NORM || delta.isNull())
+		return true;
 
-	// Execute children
-	execute_topo();
+	// Input shifted by d: the forward transform is multiplied by exp(2 pi i d k / n),
+	// the inverse transform by exp(-2 pi i d k / n). The extremes don't change.
+	size_t n = get_fft_size();
+	double sign = state.type == OperatorFFTType::INV ? -1.0 : 1.0;
+	std::vector<std::complex<double>> ramp_x = phase_ramp(n, delta.x(), sign);
+	std::vector<std::complex<double>> ramp_y = phase_ramp(n, delta.y(), sign);
+	std::complex<double> *data = assume_aligned(output_buffers[0].get_complex_data());
+	for (size_t y = 0; y < n; ++y) {
+		std::complex<double> fy = ramp_y[y];
+		for (size_t x = 0; x < n; ++x)
+			*data++ *= fy * ramp_x[x];
+	}
+	return true;
+}
+
+// Incremental updates cost about n^2 operations per changed row or column,
+// an FFT about n^2 * log2(n) operations.
+static size_t max_incremental_rank(size_t n)
+{
+	return std::bit_width(n) - 1;
+}
+
+static constexpr size_t max_incremental_updates = 64;
+
+template <typename T>
+bool OperatorFFT::apply_local_changes_doit()
+{
+	size_t n = get_fft_size();
+	size_t mask = n - 1;
+	const T *in = assume_aligned(input_connectors[0]->get_buffer().get_data<T>());
+	T *old = assume_aligned(input_snapshot->get_data<T>());
+
+	std::vector<size_t> rows, cols;
+	std::vector<bool> col_changed(n, false);
+	for (size_t y = 0; y < n; ++y) {
+		bool row_changed = false;
+		for (size_t x = 0; x < n; ++x) {
+			if (in[y * n + x] != old[y * n + x]) {
+				row_changed = true;
+				col_changed[x] = true;
+			}
+		}
+		if (row_changed)
+			rows.push_back(y);
+	}
+	for (size_t x = 0; x < n; ++x) {
+		if (col_changed[x])
+			cols.push_back(x);
+	}
+
+	size_t rank = std::min(rows.size(), cols.size());
+	if (rank > max_incremental_rank(n))
+		return false;
+	if (rank == 0)
+		return true;
+
+	// Forward transforms use exp(2 pi i jk / n), inverse transforms exp(-2 pi i jk / n).
+	double sign = state.type == OperatorFFTType::INV ? -1.0 : 1.0;
+	std::vector<std::complex<double>> roots(n);
+	for (size_t k = 0; k < n; ++k)
+		roots[k] = std::polar(1.0, sign * 2.0 * M_PI * k / n);
+
+	// The FT of the difference is a sum of rank separable terms u_j(k1) * v_j(k2):
+	// If there are fewer changed rows, v_j is the 1D-FT of the changed row j and u_j the
+	// root of its y-coordinate. Otherwise, the same for columns.
+	// The result is normalized by 1/n, as done by FFTPlan.
+	bool by_rows = rows.size() <= cols.size();
+	const std::vector<size_t> &lines = by_rows ? rows : cols;
+	const std::vector<size_t> &others = by_rows ? cols : rows;
+	double factor = 1.0 / static_cast<double>(n);
+	std::vector<std::complex<double>> u(rank * n), v(rank * n);
+	for (size_t j = 0; j < rank; ++j) {
+		size_t line = lines[j];
+		for (size_t k = 0; k < n; ++k) {
+			std::complex<double> sum = 0.0;
+			for (size_t other: others) {
+				size_t i = by_rows ? line * n + other : other * n + line;
+				sum += (in[i] - old[i]) * roots[(other * k) & mask];
+			}
+			u[j * n + k] = roots[(line * k) & mask] * factor;
+			v[j * n + k] = sum;
+		}
+	}
+
+	const std::vector<std::complex<double>> &factors_y = by_rows ? u : v;
+	const std::vector<std::complex<double>> &factors_x = by_rows ? v : u;
+	std::complex<double> *out = assume_aligned(output_buffers[0].get_complex_data());
+	Extremes extremes;
+	for (size_t ky = 0; ky < n; ++ky) {
+		std::complex<double> *line = out + ky * n;
+		for (size_t j = 0; j < rank; ++j) {
+			std::complex<double> fy = factors_y[j * n + ky];
+			const std::complex<double> *fx = &factors_x[j * n];
+			for (size_t kx = 0; kx < n; ++kx)
+				line[kx] += fy * fx[kx];
+		}
+		for (size_t kx = 0; kx < n; ++kx)
+			extremes.reg(line[kx], 1.0);
+	}
+	output_buffers[0].set_extremes(extremes);
+
+	// All changes are in the changed rows
+	for (size_t y: rows)
+		std::copy(in + y * n, in + (y + 1) * n, old + y * n);
+	return true;
+}
+
+bool OperatorFFT::apply_local_changes()
+{
+	if (!input_snapshot || num_incremental_updates >= max_incremental_updates)
+		return false;
+	bool res = input_snapshot->is_complex() ?
+		apply_local_changes_doit<std::complex<double>>() :
+		apply_local_changes_doit<double>();
+	if (res)
+		++num_incremental_updates;
+	return res;
+}
+
+void OperatorFFT::take_input_snapshot()
+{
+	Operator *parent = get_input_operator(0);
+	FFTBuf &in = input_connectors[0]->get_buffer();
+	if (!parent || !parent->has_local_changes() || !output_buffers[0].is_complex() || in.is_empty()) {
+		input_snapshot.reset();
+		return;
+	}
+
+	size_t n = get_fft_size();
+	if (!input_snapshot || input_snapshot->is_complex() != in.is_complex())
+		input_snapshot = std::make_unique<FFTBuf>(in.is_complex(), n);
+	if (in.is_complex())
+		std::copy(in.get_complex_data(), in.get_complex_data() + n * n, input_snapshot->get_complex_data());
+	else
+		std::copy(in.get_real_data(), in.get_real_data() + n * n, input_snapshot->get_real_data());
+	num_incremental_updates = 0;
 }
 
 void OperatorFFT::execute()
 {
+	if (shortcut_source)
+		return copy_shortcut_source();
 	if (!plan)
 		return;
-	plan->execute();
+	if (!apply_translation() && !apply_local_changes()) {
+		plan->execute();
+		take_input_snapshot();
+	}
+	Operator *parent = get_input_operator(0);
+	input_content = parent ? parent->get_output_content() : Operator::OutputContent();
 }
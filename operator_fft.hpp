@@ -31,8 +31,32 @@ class OperatorFFT : public OperatorTemplate<OperatorId::FFT, OperatorFFTState, 1
 	static QPixmap get_pixmap(OperatorFFTType type, int size);
 	bool update_plan();
 
+	// A FT of an inverse FT (and vice versa) is shortcut:
+	// Complex input of the parent is forwarded, real input copied.
+	bool shortcut_depends_on(const Operator &parent) const override;
+	void copy_shortcut_source();
+
+	// Translation theorem: if the input was only translated since the last execution
+	// (see Operator::get_output_content()), the previous result, which is kept in the
+	// output buffer, is multiplied by a phase ramp. The norm doesn't change at all.
+	Operator::OutputContent input_content;	// Input at the last execution, id 0 if unknown
+	bool apply_translation();
+
+	// Local changes: if the parent changes its output in small regions (see
+	// Operator::has_local_changes()), a copy of the input is kept. The FT of the
+	// difference is calculated directly over the changed rows (or columns) and
+	// added to the previous result, which is cheaper than an FFT if only few
+	// rows or columns changed. To bound the rounding errors, a full FFT is done
+	// after a number of incremental updates.
+	std::unique_ptr<FFTBuf> input_snapshot;
+	size_t num_incremental_updates = 0;
+	bool apply_local_changes();
+	template <typename T> bool apply_local_changes_doit();
+	void take_input_snapshot();
+
 	MenuButton *menu;
 	std::unique_ptr<FFTPlan> plan;
+	FFTBuf *shortcut_source = nullptr;	// Real buffer to copy if shortcut
 public:
 	using OperatorTemplate::OperatorTemplate;
 	inline static constexpr const char *icon = ":/icons/fft.svg";
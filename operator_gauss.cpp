@@ -7,6 +7,7 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QPainter>
 
+#include <algorithm>
 #include <cassert>
 
 void OperatorGauss::init()
@@ -27,7 +28,7 @@ void OperatorGauss::init()
 	new Button(":/icons/reset.svg", "Reset shape", [this](){ clear(); }, Side::left, this);
 
 	image.fill(0);
-	setPixmap(QPixmap::fromImage(image));
+	show_image(image);
 	place_handles();
 	show_handles();
 }
@@ -56,6 +57,10 @@ void OperatorGauss::state_reset()
 	place_handles();
 	calculate_gauss();
 
+	// Moving the center off the origin breaks the symmetry, which changes the transform of children
+	if (update_output_symmetry(0))
+		output_buffer_changed();
+
 	// Execute children
 	execute_topo();
 }
@@ -66,6 +71,7 @@ void OperatorGauss::placed()
 	output_buffers[0].set_extremes(Extremes(1.0));
 
 	calculate_gauss();
+	update_output_symmetry(0);
 }
 
 OperatorGauss::Handle::Handle(Type type_, const char *tooltip, Operator *parent)
@@ -240,9 +246,33 @@ void OperatorGauss::calculate()
 
 }
 
+// The Gaussian is only translated by moving its center, if it is well inside the
+// buffer (i.e. not cut at the border) and wide enough that its spectrum is negligible
+// at the Nyquist frequency. Then the translation theorem of the FT holds for
+// fractional translations as well.
+static constexpr double max_sigmas = 9.0;	// exp(-9^2/2) < 1e-17
+static constexpr double min_sigma_pixels = 3.0;
+
+bool OperatorGauss::is_translatable(const OperatorGaussState &s) const
+{
+	double half_size = get_fft_size() / 2.0;
+	double min_e = std::min(fabs(s.e1), fabs(s.e2)) * half_size;
+	double max_e = std::max(fabs(s.e1), fabs(s.e2)) * half_size;
+	return min_e >= min_sigma_pixels &&
+	       std::max(fabs(s.offset.x()), fabs(s.offset.y())) + max_sigmas * max_e <= half_size;
+}
+
 void OperatorGauss::calculate_gauss()
 {
+	bool translated = get_output_content().id != 0 &&
+			  state.e1 == calculated_state.e1 &&
+			  state.e2 == calculated_state.e2 &&
+			  state.angle == calculated_state.angle &&
+			  is_translatable(calculated_state) && is_translatable(state);
+
 	dispatch_calculate(*this);
+	set_output_origin(state.offset, !translated);
+	calculated_state = state;
 
 	// Paint ellipse
 	QPainter painter(&image);
@@ -255,7 +285,7 @@ void OperatorGauss::calculate_gauss()
 	painter.setPen(Qt::red);
 	painter.drawEllipse(QPointF(0.0,0.0), state.e1 * scale, state.e2 * scale);
 
-	setPixmap(QPixmap::fromImage(image));
+	show_image(image);
 }
 
 void OperatorGauss::clear()
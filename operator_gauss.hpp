@@ -29,6 +29,10 @@ class OperatorGauss : public OperatorTemplate<OperatorId::Gauss, OperatorGaussSt
 
 	void calculate_gauss();
 
+	// State of the last calculation, to detect if the output was only translated.
+	OperatorGaussState calculated_state;
+	bool is_translatable(const OperatorGaussState &s) const;
+
 	class Handle : public Operator::Handle {
 		void mousePressEvent(QGraphicsSceneMouseEvent *);
 	public:
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "operator_grid.hpp"
+#include "operator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+int OperatorGrid::cell_coord(double x)
+{
+	return static_cast<int>(floor(x / cell_size));
+}
+
+uint64_t OperatorGrid::cell_key(int x, int y)
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+const OperatorGrid::Cell *OperatorGrid::get_cell(int x, int y) const
+{
+	auto it = cells.find(cell_key(x, y));
+	return it != cells.end() ? &it->second : nullptr;
+}
+
+void OperatorGrid::add(Operator *op)
+{
+	QRectF rect = op->get_safety_rect();
+	int x1 = cell_coord(rect.left()), x2 = cell_coord(rect.right());
+	int y1 = cell_coord(rect.top()), y2 = cell_coord(rect.bottom());
+	for (int y = y1; y <= y2; ++y) {
+		for (int x = x1; x <= x2; ++x)
+			cells[cell_key(x, y)].push_back(op);
+	}
+	if (min_x > max_x) {
+		min_x = x1;
+		max_x = x2;
+		min_y = y1;
+		max_y = y2;
+	} else {
+		min_x = std::min(min_x, x1);
+		max_x = std::max(max_x, x2);
+		min_y = std::min(min_y, y1);
+		max_y = std::max(max_y, y2);
+	}
+}
+
+void OperatorGrid::remove(Operator *op)
+{
+	QRectF rect = op->get_safety_rect();
+	for (int y = cell_coord(rect.top()); y <= cell_coord(rect.bottom()); ++y) {
+		for (int x = cell_coord(rect.left()); x <= cell_coord(rect.right()); ++x) {
+			auto it = cells.find(cell_key(x, y));
+			assert(it != cells.end());
+			Cell &cell = it->second;
+			auto it2 = std::find(cell.begin(), cell.end(), op);
+			assert(it2 != cell.end());
+			cell.erase(it2);
+			if (cell.empty())
+				cells.erase(it);
+		}
+	}
+}
+
+void OperatorGrid::clear()
+{
+	cells.clear();
+	min_x = min_y = 0;
+	max_x = max_y = -1;
+}
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0
+// Spatial index of the operators in the scene: a uniform grid, which stores
+// for each cell the operators whose safety rectangle overlaps the cell.
+// Only cells that contain operators are allocated. Rectangle queries look
+// at the overlapped cells only, ray queries walk the cells along the ray.
+// An operator that spans multiple cells is reported once per cell.
+
+#ifndef OPERATOR_GRID_HPP
+#define OPERATOR_GRID_HPP
+
+#include <QPointF>
+#include <QRectF>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+class Operator;
+
+class OperatorGrid {
+public:
+	// Should be in the order of the size of an operator
+	static constexpr double cell_size = 128.0;
+private:
+	using Cell = std::vector<Operator *>;
+	std::unordered_map<uint64_t, Cell> cells;
+
+	// Bounds of the cells that were occupied since the last clear(), inclusive.
+	// Not shrunk on removal.
+	int min_x = 0, max_x = -1;
+	int min_y = 0, max_y = -1;
+
+	static int cell_coord(double x);
+	static uint64_t cell_key(int x, int y);
+	const Cell *get_cell(int x, int y) const;
+public:
+	// The safety rectangle of an operator must not change while it is in the grid.
+	void add(Operator *op);
+	void remove(Operator *op);
+	void clear();
+
+	// Calls fun(op) for all operators in cells overlapping rect.
+	// If fun returns true, the search is stopped and true is returned.
+	template <typename Function>
+	bool find_in_rect(const QRectF &rect, Function fun) const;
+
+	// Walks the cells touched by the line from "from" to "to" in order and calls
+	// fun(ops, t_exit) for every non-empty cell, where ops is the vector of operators
+	// in the cell and t_exit is the parameter of the line (0 at "from" and 1 at "to"),
+	// where the line leaves the cell. If fun returns true, the walk is stopped.
+	template <typename Function>
+	void walk_line(const QPointF &from, const QPointF &to, Function fun) const;
+
+	// Calls fun(cell_rect, ops) for every non-empty cell at Chebyshev distance "ring"
+	// (in cells) from the cell containing pos. Walking the rings 0, 1, 2, ... visits the
+	// cells in order of increasing distance. All cells of ring r have a distance of at
+	// least (r - 1) * cell_size from pos. Returns false if this and all following rings
+	// are outside of the occupied area.
+	template <typename Function>
+	bool walk_ring(const QPointF &pos, int ring, Function fun) const;
+};
+
+template <typename Function>
+bool OperatorGrid::find_in_rect(const QRectF &rect, Function fun) const
+{
+	int x1 = cell_coord(rect.left());
+	int x2 = cell_coord(rect.right());
+	int y1 = cell_coord(rect.top());
+	int y2 = cell_coord(rect.bottom());
+	for (int y = y1; y <= y2; ++y) {
+		for (int x = x1; x <= x2; ++x) {
+			const Cell *cell = get_cell(x, y);
+			if (!cell)
+				continue;
+			for (Operator *op: *cell) {
+				if (fun(op))
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+template <typename Function>
+void OperatorGrid::walk_line(const QPointF &from, const QPointF &to, Function fun) const
+{
+	// Classical voxel traversal: for each axis, remember the line parameter
+	// at which the next cell boundary is crossed.
+	double delta_x = to.x() - from.x();
+	double delta_y = to.y() - from.y();
+	int x = cell_coord(from.x());
+	int y = cell_coord(from.y());
+	int end_x = cell_coord(to.x());
+	int end_y = cell_coord(to.y());
+	int step_x = end_x >= x ? 1 : -1;
+	int step_y = end_y >= y ? 1 : -1;
+
+	auto first_crossing = [](double from, double delta, int cell) {
+		if (delta > 0.0)
+			return ((cell + 1) * cell_size - from) / delta;
+		if (delta < 0.0)
+			return (cell * cell_size - from) / delta;
+		return HUGE_VAL;
+	};
+	double next_t_x = first_crossing(from.x(), delta_x, x);
+	double next_t_y = first_crossing(from.y(), delta_y, y);
+	double step_t_x = delta_x != 0.0 ? cell_size / fabs(delta_x) : HUGE_VAL;
+	double step_t_y = delta_y != 0.0 ? cell_size / fabs(delta_y) : HUGE_VAL;
+
+	// Every step moves one cell towards the end cell. Clamping the axes
+	// guarantees that the end cell is reached despite rounding errors.
+	int num_steps = abs(end_x - x) + abs(end_y - y);
+	for (int i = 0; ; ++i) {
+		double t_exit = i == num_steps ? 1.0 : std::min(next_t_x, next_t_y);
+		const Cell *cell = get_cell(x, y);
+		if (cell && fun(*cell, t_exit))
+			return;
+		if (i == num_steps)
+			return;
+		if (y == end_y || (x != end_x && next_t_x < next_t_y)) {
+			x += step_x;
+			next_t_x += step_t_x;
+		} else {
+			y += step_y;
+			next_t_y += step_t_y;
+		}
+	}
+}
+
+template <typename Function>
+bool OperatorGrid::walk_ring(const QPointF &pos, int ring, Function fun) const
+{
+	int center_x = cell_coord(pos.x());
+	int center_y = cell_coord(pos.y());
+	if (min_x > max_x)
+		return false;
+	if (center_x - ring < min_x && center_x + ring > max_x &&
+	    center_y - ring < min_y && center_y + ring > max_y)
+		return false;
+
+	auto visit = [this, &fun](int x, int y) {
+		if (x < min_x || x > max_x || y < min_y || y > max_y)
+			return;
+		const Cell *cell = get_cell(x, y);
+		if (cell)
+			fun(QRectF(x * cell_size, y * cell_size, cell_size, cell_size), *cell);
+	};
+	if (ring == 0) {
+		visit(center_x, center_y);
+		return true;
+	}
+	for (int x = center_x - ring; x <= center_x + ring; ++x) {
+		visit(x, center_y - ring);
+		visit(x, center_y + ring);
+	}
+	for (int y = center_y - ring + 1; y < center_y + ring; ++y) {
+		visit(center_x - ring, y);
+		visit(center_x + ring, y);
+	}
+	return true;
+}
+
+#endif
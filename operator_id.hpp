@@ -23,6 +23,7 @@ enum class OperatorId {
 	Powder = 19,
 	Split = 12,
 	Sum = 13,
+	Symmetrize = 21,
 	View = 14,
 	Wave = 15,
 };
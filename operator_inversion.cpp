@@ -1,13 +1,26 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "operator_inversion.hpp"
 #include "document.hpp"
+#include "aligned_buf.hpp"	// For assume_aligned
+
+#include <algorithm>
 
 bool OperatorInversion::input_connection_changed()
 {
 	// Empty if the input buffer is empty.
+	set_shortcut(false);
 	if (input_connectors[0]->is_empty_buffer())
 		return make_output_empty(0);
 
+	// If the parent is an operation that is undone by this operation,
+	// forward the input of the parent.
+	auto parent = dynamic_cast<OperatorInversion *>(get_input_operator(0));
+	if (parent && !parent->input_connectors[0]->is_empty_buffer() &&
+	    is_identity(parent->state.type, state.type)) {
+		set_shortcut(true);
+		return make_output_forwarded(0, parent->input_connectors[0]->get_buffer());
+	}
+
 	FFTBuf &buf = input_connectors[0]->get_buffer();
 	if (buf.is_complex())
 		return make_output_complex(0);
@@ -112,10 +125,47 @@ void OperatorInversion::state_reset()
 	menu->set_pixmap((int)state.type);
 	setPixmap(get_pixmap(state.type, simple_size));
 
-	execute();
+	// The type decides whether this operator or its children are shortcut.
+	if (input_connection_changed())
+		output_buffer_changed();
+	update_shortcuts_of_children();
+
+	// Execute this operator and its children, if they are needed
+	execute_topo(true);
+}
+
+// Maps the point (x, y) as the reflect() and rotate() kernels below do.
+std::pair<size_t, size_t> OperatorInversion::transform_point(OperatorInversionType type, size_t x, size_t y, size_t n)
+{
+	switch (type) {
+	default:
+	case OperatorInversionType::inversion: return { n - 1 - x, n - 1 - y };
+	case OperatorInversionType::rot_4_plus: return { y, x };
+	case OperatorInversionType::rot_4_minus: return { n - 1 - y, n - 1 - x };
+	case OperatorInversionType::m_x: return { n - 1 - x, y };
+	case OperatorInversionType::m_y: return { x, n - 1 - y };
+	case OperatorInversionType::m_xy: return { y, n - 1 - x };
+	case OperatorInversionType::m_minus_xy: return { n - 1 - y, x };
+	}
+}
+
+// The operations are affine maps, so it is sufficient to test three points.
+bool OperatorInversion::is_identity(OperatorInversionType type1, OperatorInversionType type2)
+{
+	constexpr size_t n = 4;
+	std::pair<size_t, size_t> points[] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+	for (auto [x, y]: points) {
+		auto [x1, y1] = transform_point(type1, x, y, n);
+		auto [x2, y2] = transform_point(type2, x1, y1, n);
+		if (x2 != x || y2 != y)
+			return false;
+	}
+	return true;
+}
 
-	// Execute children
-	execute_topo();
+bool OperatorInversion::shortcut_depends_on(const Operator &parent) const
+{
+	return dynamic_cast<const OperatorInversion *>(&parent) != nullptr;
 }
 
 void OperatorInversion::set_type(OperatorInversionType t)
@@ -127,41 +177,48 @@ void OperatorInversion::set_type(OperatorInversionType t)
 	place_set_state_command("Set symmetry type", std::move(new_state), false);
 }
 
+// Reflections keep rows contiguous: copy whole rows, reversed if DX < 0.
 template <typename T, size_t N, int DX, int DY>
 static void reflect(FFTBuf &in_buf, FFTBuf &out_buf)
 {
-	T *in = in_buf.get_data<T>();
-	T *out = out_buf.get_data<T>();
-	if (DX < 0)
-		out += N - 1;
-	if (DY < 0)
-		out += N * (N - 1);
+	const T *in = assume_aligned(in_buf.get_data<T>());
+	T *out = assume_aligned(out_buf.get_data<T>());
 	for (size_t y = 0; y < N; ++y) {
-		for (size_t x = 0; x < N; ++x) {
-			*out = *in++;
-			out += DX;
-		}
-		out -= N * DX;
-		out += N * DY;
+		const T *in_row = in + y * N;
+		T *out_row = out + (DY < 0 ? N - 1 - y : y) * N;
+		if (DX < 0)
+			std::reverse_copy(in_row, in_row + N, out_row);
+		else
+			std::copy(in_row, in_row + N, out_row);
 	}
 }
 
+// Rotations and diagonal reflections are transposes with optional flips:
+// the element at (x, y) is written to row x (N - 1 - x if DX < 0) and
+// column y (N - 1 - y if DY < 0). Writing that naively scatters with stride N,
+// which at large sizes misses cache and TLB on every store. Therefore, work on
+// square tiles that fit into L1 together with their destination.
 template <typename T, size_t N, int DX, int DY>
 static void rotate(FFTBuf &in_buf, FFTBuf &out_buf)
 {
-	T *in = in_buf.get_data<T>();
-	T *out = out_buf.get_data<T>();
-	if (DX < 0)
-		out += N * (N - 1);
-	if (DY < 0)
-		out += N - 1;
-	for (size_t y = 0; y < N; ++y) {
-		for (size_t x = 0; x < N; ++x) {
-			*out = *in++;
-			out += N * DX;
+	constexpr size_t tile_size = std::min(N, 256 / sizeof(T));
+	static_assert(N % tile_size == 0);
+
+	const T *in = assume_aligned(in_buf.get_data<T>());
+	T *out = assume_aligned(out_buf.get_data<T>());
+	for (size_t tile_y = 0; tile_y < N; tile_y += tile_size) {
+		for (size_t tile_x = 0; tile_x < N; tile_x += tile_size) {
+			// Iterate over the columns of the input tile,
+			// so that the stores go to consecutive memory.
+			for (size_t x = tile_x; x < tile_x + tile_size; ++x) {
+				const T *in_col = in + tile_y * N + x;
+				T *out_row = out + (DX < 0 ? N - 1 - x : x) * N;
+				for (size_t y = tile_y; y < tile_y + tile_size; ++y) {
+					out_row[DY < 0 ? N - 1 - y : y] = *in_col;
+					in_col += N;
+				}
+			}
 		}
-		out -= N * N * DX;
-		out += DY;
 	}
 }
 
@@ -196,8 +253,8 @@ void OperatorInversion::calculate()
 
 void OperatorInversion::execute()
 {
-	if (input_connectors[0]->is_empty_buffer())
-		return; // Empty -> nothing to do
+	if (input_connectors[0]->is_empty_buffer() || output_buffers[0].is_forwarded())
+		return; // Empty or shortcut -> nothing to do
 
 	dispatch_calculate(*this);
 }
@@ -34,6 +34,11 @@ class OperatorInversion : public OperatorTemplate<OperatorId::Inversion, Operato
 	static const char *get_pixmap_name(OperatorInversionType type);
 	static QPixmap get_pixmap(OperatorInversionType type, int size);
 	static const char *get_tooltip(OperatorInversionType type);
+
+	// Shortcut if the operation undoes the operation of the parent.
+	static std::pair<size_t, size_t> transform_point(OperatorInversionType type, size_t x, size_t y, size_t n);
+	static bool is_identity(OperatorInversionType type1, OperatorInversionType type2);
+	bool shortcut_depends_on(const Operator &parent) const override;
 public:
 	inline static constexpr const char *icon = ":/icons/inversion.svg";
 	inline static constexpr const char *tooltip = "Add Operation";
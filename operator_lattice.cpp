@@ -38,7 +38,7 @@ void OperatorLattice::init()
 	size_t n = get_fft_size();
 	image = QImage(n, n, QImage::Format_Grayscale8);
 	image.fill(0);
-	setPixmap(QPixmap::fromImage(image));
+	show_image(image);
 	dont_accumulate_undo = true;
 	handles_visible = true;
 
@@ -429,12 +429,16 @@ void OperatorLattice::paint_lattice()
 		break;
 	}
 
-	setPixmap(QPixmap::fromImage(image));
+	show_image(image);
 	paint_basis();
 }
 
 void OperatorLattice::update_buffer()
 {
+	// Lattices are usually centrosymmetric, but not if cut asymmetrically at the border
+	if (update_output_symmetry(0))
+		output_buffer_changed();
+
 	// Execute children
 	execute_topo();
 }
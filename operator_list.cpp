@@ -2,9 +2,12 @@
 #include "operator_list.hpp"
 #include "operator.hpp"
 #include "edge.hpp"
+#include "parallel.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <unordered_set>
 
 bool operator<(double boundary, const OperatorList::Entry &e)
 {
@@ -40,12 +43,182 @@ void OperatorList::remove(Operator *op, std::vector<Entry> &list)
 	list.erase(it);
 }
 
+// Check whether the line hits a safety rectangle.
+// Only the walls facing the line are considered and the line must cross them.
+// On a hit, returns the parameter of the line (0 at "from" and 1 at "to"), otherwise infinity.
+static double hit_rect(const QRectF &rect, const QPointF &from, const QPointF &to, QPointF &hit_at)
+{
+	double delta_x = to.x() - from.x();
+	double delta_y = to.y() - from.y();
+	double res = HUGE_VAL;
+
+	// We don't have to check horizontal wall for vertical lines
+	if (fabs(delta_x) > 0.01) {
+		double boundary = delta_x > 0.0 ? rect.left() : rect.right();
+		bool crossed = delta_x > 0.0 ? boundary > from.x() && boundary < to.x()
+					     : boundary < from.x() && boundary >= to.x();
+		if (crossed) {
+			// Calculate line equation of the form y = ax+b
+			double a = delta_y / delta_x;
+			double b = from.y() - a * from.x();
+			double y_pos = a * boundary + b;
+			if (y_pos >= rect.top() && y_pos <= rect.bottom()) {
+				res = (boundary - from.x()) / delta_x;
+				hit_at = QPointF(boundary, y_pos);
+			}
+		}
+	}
+
+	// We don't have to check vertical wall for horizontal lines
+	if (fabs(delta_y) > 0.01) {
+		double boundary = delta_y > 0.0 ? rect.top() : rect.bottom();
+		bool crossed = delta_y > 0.0 ? boundary > from.y() && boundary < to.y()
+					     : boundary < from.y() && boundary >= to.y();
+		if (crossed) {
+			// Calculate line equation of the form x = ay+b
+			double a = delta_x / delta_y;
+			double b = from.x() - a * from.y();
+			double x_pos = a * boundary + b;
+			double t = (boundary - from.y()) / delta_y;
+			if (x_pos >= rect.left() && x_pos <= rect.right() && t < res) {
+				res = t;
+				hit_at = QPointF(x_pos, boundary);
+			}
+		}
+	}
+	return res;
+}
+
+static double max_dist(const QPointF &pos, const QRectF &rect)
+{
+	double dx = std::max(fabs(pos.x() - rect.left()), fabs(pos.x() - rect.right()));
+	double dy = std::max(fabs(pos.y() - rect.top()), fabs(pos.y() - rect.bottom()));
+	return sqrt(dx*dx + dy*dy);
+}
+
+static double min_dist(const QPointF &pos, const QRectF &rect)
+{
+	double dx = std::max({ rect.left() - pos.x(), 0.0, pos.x() - rect.right() });
+	double dy = std::max({ rect.top() - pos.y(), 0.0, pos.y() - rect.bottom() });
+	return sqrt(dx*dx + dy*dy);
+}
+
+// Angular shadows of operators as seen from a point. Points and rectangles hidden
+// in a shadow can certainly not be seen from that point, so that the more expensive
+// path query can be skipped. Operators should be added from near to far, which
+// makes most of the far points hidden.
+// For sectors of directions, the distance beyond which everything is hidden is stored.
+// A rectangle only hides the sectors that lie strictly inside of its angular span,
+// shrunk by a margin. Thus, lines through these sectors cross a wall of the rectangle
+// by more than the tolerance of hit_rect().
+class ShadowSweep {
+	static constexpr int num_sectors = 1024;
+	static constexpr double sector_size = 2.0 * M_PI / num_sectors;
+	static constexpr double margin = 1.0;		// Pixels
+	static constexpr double angle_epsilon = 1e-9;
+	QPointF pos;
+	std::vector<double> hidden_beyond;
+
+	// Angular span [a1, a2] of a rectangle that doesn't contain pos. May exceed [-pi, pi].
+	void get_span(const QRectF &rect, double &a1, double &a2) const;
+	static int sector(double angle);
+	static double sector_center(int i);
+public:
+	ShadowSweep(const QPointF &pos);
+	void add(const QRectF &rect);
+	bool hidden(const QPointF &p) const;
+	bool hidden(const QRectF &rect) const;	// The whole rectangle is hidden
+	bool all_hidden_beyond(double dist) const;
+};
+
+ShadowSweep::ShadowSweep(const QPointF &pos_)
+	: pos(pos_)
+	, hidden_beyond(num_sectors, HUGE_VAL)
+{
+}
+
+void ShadowSweep::get_span(const QRectF &rect, double &a1, double &a2) const
+{
+	// Angles of the corners relative to the direction of the center
+	QPointF c = rect.center() - pos;
+	double center_angle = atan2(c.y(), c.x());
+	a1 = a2 = 0.0;
+	for (QPointF corner: { rect.topLeft(), rect.topRight(), rect.bottomLeft(), rect.bottomRight() }) {
+		QPointF v = corner - pos;
+		double a = atan2(c.x() * v.y() - c.y() * v.x(), c.x() * v.x() + c.y() * v.y());
+		a1 = std::min(a1, a);
+		a2 = std::max(a2, a);
+	}
+	a1 += center_angle;
+	a2 += center_angle;
+}
+
+// Sector of an angle, which may be outside of [-pi, pi]
+int ShadowSweep::sector(double angle)
+{
+	int res = static_cast<int>(floor((angle + M_PI) / sector_size)) % num_sectors;
+	return res < 0 ? res + num_sectors : res;
+}
+
+double ShadowSweep::sector_center(int i)
+{
+	return (i + 0.5) * sector_size - M_PI;
+}
+
+void ShadowSweep::add(const QRectF &rect)
+{
+	// Rectangles (almost) touching the point cover up to half of the
+	// view and are hit only partially by the path query. Ignore them.
+	QRectF inner = rect.adjusted(margin, margin, -margin, -margin);
+	if (inner.isEmpty() || min_dist(pos, rect) <= margin)
+		return;
+	double a1, a2;
+	get_span(inner, a1, a2);
+	a1 += angle_epsilon;
+	a2 -= angle_epsilon;
+
+	// Sectors strictly inside [a1, a2]
+	double dist = max_dist(pos, rect);
+	int first = static_cast<int>(floor((a1 + M_PI) / sector_size)) + 1;
+	int last = static_cast<int>(ceil((a2 + M_PI) / sector_size)) - 2;
+	for (int i = first; i <= last; ++i) {
+		double &d = hidden_beyond[sector(sector_center(i))];
+		d = std::min(d, dist);
+	}
+}
+
+bool ShadowSweep::hidden(const QPointF &p) const
+{
+	QPointF d = p - pos;
+	double dist = sqrt(d.x() * d.x() + d.y() * d.y());
+	return dist > hidden_beyond[sector(atan2(d.y(), d.x()))];
+}
+
+bool ShadowSweep::hidden(const QRectF &rect) const
+{
+	double dist = min_dist(pos, rect);
+	if (dist == 0.0)
+		return false;
+	double a1, a2;
+	get_span(rect, a1, a2);
+	int first = static_cast<int>(floor((a1 - angle_epsilon + M_PI) / sector_size));
+	int last = static_cast<int>(floor((a2 + angle_epsilon + M_PI) / sector_size));
+	for (int i = first; i <= last; ++i) {
+		if (hidden_beyond[sector(sector_center(i))] >= dist)
+			return false;
+	}
+	return true;
+}
+
+bool ShadowSweep::all_hidden_beyond(double dist) const
+{
+	return std::all_of(hidden_beyond.begin(), hidden_beyond.end(),
+			   [dist](double d) { return d < dist; });
+}
+
 OperatorList::OperatorList()
 {
 	left_list.reserve(24);
-	right_list.reserve(24);
-	top_list.reserve(24);
-	bottom_list.reserve(24);
 }
 
 void OperatorList::add_view_connection(Operator *op_from, const ConnectorPos &pos_from,
@@ -54,64 +227,86 @@ void OperatorList::add_view_connection(Operator *op_from, const ConnectorPos &po
 {
 	ConnectorDesc from(op_from, pos_from.type);
 	ConnectorDesc to(op_to, pos_to.type);
-	view_connections.emplace_back(from, pos_from.pos, to, pos_to.pos, scene);
-	view_iterator it = std::prev(view_connections.end());
+	size_t id;
+	if (free_view_connections.empty()) {
+		id = view_connections.size();
+		view_connections.emplace_back();
+	} else {
+		id = free_view_connections.back();
+		free_view_connections.pop_back();
+	}
+	view_iterator it = &view_connections[id].emplace(from, pos_from.pos, to, pos_to.pos, id, scene);
 	op_from->add_view_connection(pos_from.type, it);
 	op_to->add_view_connection(pos_to.type, it);
 }
 
-// If the last parameter is true, check before whether this connection already exists.
-// This is used when deleting an operator and the connection might already exist.
-void OperatorList::make_view_connections(Operator *op_from, const ConnectorPos &pos_from,
-					 Operator *op_to, const ConnectorPos &pos_to,
-					 Scene &scene, bool check_existing)
+// Check whether paths may go from one connector to the other without making
+// a turn at either operator. This does not check for obstructing operators.
+bool OperatorList::valid_directions(const ConnectorPos &pos_from, const ConnectorPos &pos_to)
 {
 	double delta_x = pos_to.pos.x() - pos_from.pos.x();
 	double delta_y = pos_to.pos.y() - pos_from.pos.y();
 	if (pos_from.type.is_input_connector()) {
 		if (delta_x > 0.0)
-			return;
+			return false;
 	} else if (pos_from.type.is_output_connector()) {
 		if (delta_x < 0.0)
-			return;
+			return false;
 	} else {
 		switch (pos_from.type.corner_id()) {
 		case 0:
-			if (delta_x < 0.0 && delta_y < 0.0) return;
+			if (delta_x < 0.0 && delta_y < 0.0) return false;
 			break;
 		case 1:
-			if (delta_x < 0.0 && delta_y > 0.0) return;
+			if (delta_x < 0.0 && delta_y > 0.0) return false;
 			break;
 		case 2:
-			if (delta_x > 0.0 && delta_y > 0.0) return;
+			if (delta_x > 0.0 && delta_y > 0.0) return false;
 			break;
 		case 3:
-			if (delta_x > 0.0 && delta_y < 0.0) return;
+			if (delta_x > 0.0 && delta_y < 0.0) return false;
 			break;
 		}
 	}
 	if (pos_to.type.is_input_connector()) {
 		if (delta_x < 0.0)
-			return;
+			return false;
 	} else if (pos_to.type.is_output_connector()) {
 		if (delta_x > 0.0)
-			return;
+			return false;
 	} else {
 		switch (pos_to.type.corner_id()) {
 		case 0:
-			if (delta_x > 0.0 && delta_y > 0.0) return;
+			if (delta_x > 0.0 && delta_y > 0.0) return false;
 			break;
 		case 1:
-			if (delta_x > 0.0 && delta_y < 0.0) return;
+			if (delta_x > 0.0 && delta_y < 0.0) return false;
 			break;
 		case 2:
-			if (delta_x < 0.0 && delta_y < 0.0) return;
+			if (delta_x < 0.0 && delta_y < 0.0) return false;
 			break;
 		case 3:
-			if (delta_x < 0.0 && delta_y > 0.0) return;
+			if (delta_x < 0.0 && delta_y > 0.0) return false;
 			break;
 		}
 	}
+	return true;
+}
+
+bool OperatorList::is_visible(const ConnectorPos &pos_from, const ConnectorPos &pos_to, const Operator *op_to) const
+{
+	QPointF dummy;
+	return find_first_in_path(pos_from.pos, pos_to.pos, dummy, op_to) == nullptr;
+}
+
+// If the last parameter is true, check before whether this connection already exists.
+// This is used when deleting an operator and the connection might already exist.
+void OperatorList::make_view_connections(Operator *op_from, const ConnectorPos &pos_from,
+					 Operator *op_to, const ConnectorPos &pos_to,
+					 Scene &scene, bool check_existing)
+{
+	if (!valid_directions(pos_from, pos_to))
+		return;
 
 	if (check_existing) {
 		const view_list &view_list = op_from->get_view_list(pos_from.type);
@@ -124,10 +319,10 @@ void OperatorList::make_view_connections(Operator *op_from, const ConnectorPos &
 		}
 	}
 
-	QPointF dummy;
-	Operator *hit = find_first_in_path(pos_from.pos, pos_to.pos, dummy, op_to);
-	if (hit == nullptr)
-		add_view_connection(op_from, pos_from, op_to, pos_to, scene);
+	if (!is_visible(pos_from, pos_to, op_to))
+		return;
+
+	add_view_connection(op_from, pos_from, op_to, pos_to, scene);
 }
 
 void OperatorList::add_intra_op_view_connection(Operator *op, int corner_from, int corner_to, Scene &scene)
@@ -148,6 +343,29 @@ void OperatorList::add_intra_op_view_connection(Operator *op, const ConnectorPos
 	add_view_connection(op, pos_from, op, pos_to, scene);
 }
 
+// Add inter-operator connectivities, so that we can go around corners
+void OperatorList::add_intra_op_view_connections(Operator *op, Scene &scene)
+{
+	for (size_t i = 0; i < 4; ++i)
+		add_intra_op_view_connection(op, i, (i + 1) % 4, scene);
+
+	const ConnectorPos *prev = nullptr;
+	for (const ConnectorPos &conn: op->get_connector_pos()) {
+		if (conn.type.is_corner())
+			continue;
+		if (conn.type.is_input_connector()) {
+			add_intra_op_view_connection(op, 2, conn, scene);
+			add_intra_op_view_connection(op, 3, conn, scene);
+		} else {
+			add_intra_op_view_connection(op, 0, conn, scene);
+			add_intra_op_view_connection(op, 1, conn, scene);
+		}
+		if (prev && prev->type.is_input_connector() == conn.type.is_input_connector())
+			add_intra_op_view_connection(op, *prev, conn, scene);
+		prev = &conn;
+	}
+}
+
 void OperatorList::add(Operator *op, Scene &scene)
 {
 	QRectF rect = op->get_safety_rect();
@@ -156,69 +374,115 @@ void OperatorList::add(Operator *op, Scene &scene)
 	// these have to be removed. Edges using this connections
 	// are collected, because their path has to be recalculated later on
 	std::vector<Edge *> edges_to_recalculate;
-	for (auto it = view_connections.begin(); it != view_connections.end(); ) {
-		auto next_it = std::next(it);
-		if (it->cuts_rect(rect)) {
+	for (std::optional<ViewConnection> &v: view_connections) {
+		if (v && v->cuts_rect(rect)) {
 			// We copy the vector, because removing edges will modify the original vector
-			std::vector<Edge *> edges = it->get_edges();
+			std::vector<Edge *> edges = v->get_edges();
 			for (Edge *e: edges)
 				e->unregister_view_connections();
-			assert(!it->used_by_edge());
+			assert(!v->used_by_edge());
 			edges_to_recalculate.insert(edges_to_recalculate.end(), edges.begin(), edges.end());
-			view_connections.erase(it);
+			remove_view(&*v);
 		}
-		it = next_it;
 	}
 
 	// Before inserting, generate all view connections.
-	// We could speed this up by remembering which parts are shadowed -
-	// but is it worth the trouble?
-	const std::vector<ConnectorPos> &connectors = op->get_connector_pos();
-	for (Entry &entry: left_list) {
-		for (const ConnectorPos &from: connectors) {
-			for (const ConnectorPos &to: entry.op->get_connector_pos())
-				make_view_connections(op, from, entry.op, to, scene, false);
+	// Visit the other operators from near to far. Thus, connectors hidden
+	// behind nearer operators are quickly recognized and skipped.
+	std::vector<Operator *> others;
+	others.reserve(left_list.size());
+	for (Entry &entry: left_list)
+		others.push_back(entry.op);
+	QPointF center = rect.center();
+	auto dist = [&center](const Operator *op) {
+		QPointF d = op->get_safety_rect().center() - center;
+		return d.x() * d.x() + d.y() * d.y();
+	};
+	std::sort(others.begin(), others.end(),
+		  [&dist](const Operator *op1, const Operator *op2) { return dist(op1) < dist(op2); });
+
+	for (const ConnectorPos &from: op->get_connector_pos()) {
+		ShadowSweep sweep(from.pos);
+		for (Operator *other: others) {
+			for (const ConnectorPos &to: other->get_connector_pos()) {
+				if (valid_directions(from, to) && !sweep.hidden(to.pos) && is_visible(from, to, other))
+					add_view_connection(op, from, other, to, scene);
+			}
+			sweep.add(other->get_safety_rect());
 		}
 	}
 
-	// Add inter-operator connectivities, so that we can go around corners
-	for (size_t i = 0; i < 4; ++i)
-		add_intra_op_view_connection(op, i, (i + 1) % 4, scene);
-
-	const ConnectorPos *prev = nullptr;
-	for (const ConnectorPos &conn: connectors) {
-		if (conn.type.is_corner())
-			continue;
-		if (conn.type.is_input_connector()) {
-			add_intra_op_view_connection(op, 2, conn, scene);
-			add_intra_op_view_connection(op, 3, conn, scene);
-		} else {
-			add_intra_op_view_connection(op, 0, conn, scene);
-			add_intra_op_view_connection(op, 1, conn, scene);
-		}
-		if (prev && prev->type.is_input_connector() == conn.type.is_input_connector())
-			add_intra_op_view_connection(op, *prev, conn, scene);
-		prev = &conn;
-	}
+	add_intra_op_view_connections(op, scene);
 
 	add(op, rect.left(), left_list);
-	add(op, rect.right(), right_list);
-	add(op, rect.top(), top_list);
-	add(op, rect.bottom(), bottom_list);
+	grid.add(op);
 
 	// Recalculate edges
 	for (Edge *e: edges_to_recalculate)
 		e->recalculate();
 }
 
+void OperatorList::add_bulk(const std::vector<Operator *> &ops, Scene &scene)
+{
+	// Adding operators one by one would cut existing view connections.
+	// To avoid that, bulk adding is only supported for an empty list.
+	assert(left_list.empty() && view_connections.empty());
+	if (ops.empty())
+		return;
+
+	for (Operator *op: ops) {
+		left_list.emplace_back(op, op->get_safety_rect().left());
+		grid.add(op);
+	}
+	std::stable_sort(left_list.begin(), left_list.end(),
+			 [](const Entry &e1, const Entry &e2) { return e1.boundary < e2.boundary; });
+
+	// Now that all operators are known, every pair of operators has to be checked only once.
+	// The visibility checks only read the spatial index, so they can be done in parallel.
+	// The view connections themselves are created afterwards in a fixed order.
+	struct Candidate {
+		Operator *op_from;
+		const ConnectorPos *pos_from;
+		Operator *op_to;
+		const ConnectorPos *pos_to;
+	};
+	size_t num = left_list.size();
+	std::vector<std::vector<Candidate>> candidates(num);
+	auto check_operator = [this, num, &candidates](size_t i) {
+		Operator *op1 = left_list[i].op;
+		for (size_t j = i + 1; j < num; ++j) {
+			Operator *op2 = left_list[j].op;
+			for (const ConnectorPos &from: op1->get_connector_pos()) {
+				for (const ConnectorPos &to: op2->get_connector_pos()) {
+					if (valid_directions(from, to) && is_visible(from, to, op2))
+						candidates[i].push_back({ op1, &from, op2, &to });
+				}
+			}
+		}
+	};
+	// The first operators have to be checked against more partners.
+	// Balance the work by processing operators from both ends of the list.
+	parallel_for((num + 1) / 2, [num, &check_operator](size_t i) {
+		check_operator(i);
+		if (num - 1 - i != i)
+			check_operator(num - 1 - i);
+	});
+
+	for (Operator *op: ops)
+		add_intra_op_view_connections(op, scene);
+	for (const std::vector<Candidate> &v: candidates) {
+		for (const Candidate &c: v)
+			add_view_connection(c.op_from, *c.pos_from, c.op_to, *c.pos_to, scene);
+	}
+}
+
 void OperatorList::remove(Operator *op, Scene &scene)
 {
 	remove(op, left_list);
-	remove(op, right_list);
-	remove(op, top_list);
-	remove(op, bottom_list);
+	grid.remove(op);
 
 	// Reconstruct the views that were blocked by this operator.
+	// Only lines that were obstructed by the removed operator have to be checked.
 	QRectF removed_rect = op->get_safety_rect();
 
 	// We loop from left to right. Thus we only have to connect output to input connectors.
@@ -245,7 +509,9 @@ void OperatorList::remove(Operator *op, Scene &scene)
 
 			for (const ConnectorPos &from: connectors) {
 				for (const ConnectorPos &to: op2->get_connector_pos()) {
-					make_view_connections(op1, from, op2, to, scene, true);
+					QPointF dummy;
+					if (hit_rect(removed_rect, from.pos, to.pos, dummy) != HUGE_VAL)
+						make_view_connections(op1, from, op2, to, scene, true);
 				}
 			}
 		}
@@ -254,124 +520,51 @@ void OperatorList::remove(Operator *op, Scene &scene)
 
 void OperatorList::remove_view(const view_iterator &it)
 {
-	view_connections.erase(it);
-}
-
-bool OperatorList::check_hit(Operator *op, bool left_right, double boundary, double a, double b, QPointF &hit_at) const
-{
-	double y_pos = a*boundary + b;
-	QRectF rect = op->get_safety_rect();
-	if (left_right) {
-		if (y_pos >= rect.top() && y_pos <= rect.bottom()) {
-			hit_at = QPointF(boundary, y_pos);
-			return true;
-		}
-	} else {
-		if (y_pos >= rect.left() && y_pos <= rect.right()) {
-			hit_at = QPointF(y_pos, boundary);
-			return true;
-		}
-	}
-	return false;
-}
-
-Operator *OperatorList::find_first_hit(const std::vector<Entry> &list, bool go_up, bool left_right,
-				       double from, double to, double a, double b, QPointF &hit_at,
-				       const Operator *ignore) const
-{
-	if (list.empty())
-		return nullptr;
-	if (go_up) {
-		assert(from < to);
-		auto it = upper_bound(list.begin(), list.end(), from);
-		while (it != list.end() && it->boundary < to) {
-			if (it->op != ignore && check_hit(it->op, left_right, it->boundary, a, b, hit_at))
-				return it->op;
-			++it;
-		}
-	} else {
-		assert(to < from);
-		auto it = lower_bound(list.begin(), list.end(), from);
-		while (it != list.begin()) {
-			--it;
-			if (it->boundary < to)
-				break;
-			if (it->op != ignore && check_hit(it->op, left_right, it->boundary, a, b, hit_at))
-				return it->op;
-		}
-	}
-	return nullptr;
+	size_t id = it->get_id();
+	view_connections[id].reset();
+	free_view_connections.push_back(id);
 }
 
 Operator *OperatorList::find_first_in_path(const QPointF &from, const QPointF &to, QPointF &hit_at, const Operator *ignore) const
 {
-	double delta_x = to.x() - from.x();
-	double delta_y = to.y() - from.y();
-
-	// We search for the first horizontal wall we hit and
-	// the first vertical wall we hit. Then check which one
-	// of the two we hit first.
-	QPointF hit_at_horizontal;
-	Operator *hit_horizontal = nullptr;
-
-	// We don't have to check horizontal wall for vertical lines
-	if (fabs(delta_x) > 0.01) {
-		// Calculate line equation of the form y = ax+b
-		double a = delta_y / delta_x;
-		double b = from.y() - a * from.x();
-		hit_horizontal = delta_x > 0
-			? find_first_hit(left_list, true, true, from.x(), to.x(), a, b, hit_at_horizontal, ignore)
-			: find_first_hit(right_list, false, true, from.x(), to.x(), a, b, hit_at_horizontal, ignore);
-	}
-
-	QPointF hit_at_vertical;
-	Operator *hit_vertical = nullptr;
-
-	// We don't have to check vertical wall for horizontal lines
-	if (fabs(delta_y) > 0.01) {
-		// Calculate line equation of the form x = ay+b
-		double a = delta_x / delta_y;
-		double b = from.x() - a * from.y();
-		hit_vertical = delta_y > 0
-			? find_first_hit(top_list, true, false, from.y(), to.y(), a, b, hit_at_vertical, ignore)
-			: find_first_hit(bottom_list, false, false, from.y(), to.y(), a, b, hit_at_vertical, ignore);
-	}
-
-	if (!hit_horizontal && !hit_vertical)
-		return nullptr;
-
-	if (!hit_horizontal || (hit_vertical && (delta_x > 0.0) == (hit_at_vertical.x() < hit_at_horizontal.x()))) {
-		hit_at = hit_at_vertical;
-		return hit_vertical;
-	} else {
-		hit_at = hit_at_horizontal;
-		return hit_horizontal;
-	}
+	// Walk the grid cells along the path. Once an operator was hit,
+	// we can stop after the cell containing the hit point.
+	Operator *res = nullptr;
+	double best_t = HUGE_VAL;
+	grid.walk_line(from, to, [&](const std::vector<Operator *> &ops, double t_exit) {
+		for (Operator *op: ops) {
+			if (op == ignore)
+				continue;
+			QPointF pos;
+			double t = hit_rect(op->get_safety_rect(), from, to, pos);
+			if (t < best_t) {
+				best_t = t;
+				hit_at = pos;
+				res = op;
+			}
+		}
+		return best_t <= t_exit;
+	});
+	return res;
 }
 
-// TODO: For the following two accessors, check in which list we have the least to search
 Operator *OperatorList::get_operator_by_safety_rect(const QPointF &pos) const
 {
-	auto it = upper_bound(left_list.begin(), left_list.end(), pos.x());
-	while (it != left_list.begin()) {
-		--it;
-		QRectF rect = it->op->get_safety_rect();
-		if (rect.contains(pos))
-			return it->op;
-	}
-	return nullptr;
+	Operator *res = nullptr;
+	grid.find_in_rect(QRectF(pos, pos), [&pos, &res](Operator *op) {
+		if (!op->get_safety_rect().contains(pos))
+			return false;
+		res = op;
+		return true;
+	});
+	return res;
 }
 
 bool OperatorList::operator_in_rect(const QRectF &rect) const
 {
-	auto it = upper_bound(left_list.begin(), left_list.end(), rect.right());
-	while (it != left_list.begin()) {
-		--it;
-		QRectF safety_rect = it->op->get_safety_rect();
-		if (safety_rect.intersects(rect))
-			return true;
-	}
-	return false;
+	return grid.find_in_rect(rect, [&rect](Operator *op) {
+		return op->get_safety_rect().intersects(rect);
+	});
 }
 
 static double euclidean_dist(const QPointF &p1, const QPointF &p2)
@@ -387,27 +580,42 @@ CornerDistance::CornerDistance(Operator *op, int corner_id, QPointF pos_, double
 {
 }
 
+// Visit the operators in rings of grid cells of increasing distance. Cells that are
+// completely hidden by the operators closer to pos can't contain visible corners
+// and are skipped. Once everything beyond the current ring is hidden, stop.
 std::vector<CornerDistance> OperatorList::get_visible_corners(const QPointF &pos) const
 {
-	size_t num_operators = left_list.size();
 	std::vector<CornerDistance> res;
-	res.reserve(3 * num_operators);		// One can see at the most three corners of a rectangle.
+	std::unordered_set<const Operator *> visited;
+	ShadowSweep sweep(pos);
 
-	for (const Entry &e: left_list) {
-		Operator *op = e.op;
-		int visible_corners = op->visible_corners(pos);
-		for (int i = 0; i < 4; ++i) {
-			if ((visible_corners & (1 << i)) == 0)
-				continue;
-			QPointF corner_pos = op->corner_coord(i);
-			QPointF dummy;
-			Operator *hit = find_first_in_path(pos, corner_pos, dummy, op);
-			if (hit)
+	auto visit_cell = [&](const QRectF &cell_rect, const std::vector<Operator *> &ops) {
+		if (sweep.hidden(cell_rect))
+			return;
+		for (Operator *op: ops) {
+			if (!visited.insert(op).second)
 				continue;
 
-			double dist = euclidean_dist(pos, corner_pos);
-			res.emplace_back(op, i, corner_pos, dist);
+			int visible_corners = op->visible_corners(pos);
+			for (int i = 0; i < 4; ++i) {
+				if ((visible_corners & (1 << i)) == 0)
+					continue;
+				QPointF corner_pos = op->corner_coord(i);
+				QPointF dummy;
+				Operator *hit = find_first_in_path(pos, corner_pos, dummy, op);
+				if (hit)
+					continue;
+
+				double dist = euclidean_dist(pos, corner_pos);
+				res.emplace_back(op, i, corner_pos, dist);
+			}
+			sweep.add(op->get_safety_rect());
 		}
+	};
+
+	for (int ring = 0; grid.walk_ring(pos, ring, visit_cell); ++ring) {
+		if (sweep.all_hidden_beyond(ring * OperatorGrid::cell_size))
+			break;
 	}
 	return res;
 }
@@ -423,10 +631,9 @@ void OperatorList::clear()
 	for (Entry &e: left_list)
 		e.op->remove_edges();
 	view_connections.clear();
+	free_view_connections.clear();
 	for (Entry &e: left_list)
 		delete e.op;
-	right_list.clear();
 	left_list.clear();
-	top_list.clear();
-	bottom_list.clear();
+	grid.clear();
 }
@@ -1,15 +1,16 @@
 // SPDX-License-Identifier: GPL-2.0
 // This class keeps track of the operators in the scene
-// Operators are sorted by right, left, top and bottom boundaries to
-// make a rather quick collision check possible.
-// A quad- or R-tree might be more efficient.
+// Operators are sorted by their left boundary and stored in a uniform grid
+// (see operator_grid.hpp) to make quick collision checks possible.
 #ifndef OPERATOR_LIST_HPP
 #define OPERATOR_LIST_HPP
 
 #include "view_connection.hpp"
+#include "operator_grid.hpp"
 
+#include <deque>
+#include <optional>
 #include <vector>
-#include <list>
 
 class Scene;
 
@@ -31,28 +32,30 @@ public:
 	};
 private:
 	// Since operators will be added only rather sparingly, we keep them in
-	// pre-sorted vectors that can be searched quickly.
-	std::vector<Entry> right_list;
+	// a vector sorted by left boundary, which is used to iterate from left to right.
 	std::vector<Entry> left_list;
-	std::vector<Entry> top_list;
-	std::vector<Entry> bottom_list;
 
-	// List of all view connections
-	std::list<ViewConnection> view_connections;
+	// Spatial index for collision and path queries
+	OperatorGrid grid;
+
+	// Pool of all view connections. Elements of a deque don't move, so that operators
+	// and edges can refer to view connections by pointer. Free slots are reused,
+	// so that adding and removing view connections doesn't allocate nodes.
+	std::deque<std::optional<ViewConnection>> view_connections;
+	std::vector<size_t> free_view_connections;
 public:
-	using view_iterator = std::list<ViewConnection>::iterator;
-	using view_list = std::list<view_iterator>;
+	using view_iterator = ViewConnection *;
+	using view_list = std::vector<view_iterator>;
 private:
 	static void add(Operator *, double boundary, std::vector<Entry> &list);
 	static void remove(Operator *, std::vector<Entry> &list);
 
-	bool check_hit(Operator *, bool left_right, double boundary, double a, double b, QPointF &hit_at) const;
-	Operator *find_first_hit(const std::vector<Entry> &list, bool go_up, bool left_right,
-				 double from, double to, double a, double b, QPointF &hit_at,
-				 const Operator *ignore) const;
+	static bool valid_directions(const ConnectorPos &pos_from, const ConnectorPos &pos_to);
+	bool is_visible(const ConnectorPos &pos_from, const ConnectorPos &pos_to, const Operator *op_to) const;
 	void make_view_connections(Operator *op_from, const ConnectorPos &pos_from,
 				   Operator *op_to, const ConnectorPos &pos_to,
 				   Scene &scene, bool check_existing);
+	void add_intra_op_view_connections(Operator *op, Scene &scene);
 	void add_intra_op_view_connection(Operator *op, int corner_from, int corner_to, Scene &scene);
 	void add_intra_op_view_connection(Operator *op, int corner_from, const ConnectorPos &pos_to, Scene &scene);
 	void add_intra_op_view_connection(Operator *op, const ConnectorPos &from, const ConnectorPos &pos_to, Scene &scene);
@@ -63,6 +66,10 @@ private:
 public:
 	OperatorList();
 	void add(Operator *, Scene &scene);
+
+	// Add many operators at once, which is much faster than adding them one by one.
+	// Used when loading documents. The list must be empty.
+	void add_bulk(const std::vector<Operator *> &ops, Scene &scene);
 	void remove(Operator *, Scene &scene);
 	void remove_view(const view_iterator &it);
 	size_t num_operators() const;
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "operator_merge.hpp"
 #include "document.hpp"
+#include "complex_math.hpp"
 
 void OperatorMerge::init()
 {
@@ -39,82 +40,73 @@ bool OperatorMerge::input_connection_changed()
 	return make_output_complex(0);
 }
 
-template<size_t N>
-void OperatorMerge::calculate()
+void OperatorMerge::execute()
+{
+	execute_pointwise();
+}
+
+bool OperatorMerge::is_pointwise() const
 {
-	constexpr size_t n = N*N;
+	return true;
+}
+
+void OperatorMerge::execute_range(size_t begin, size_t end)
+{
+	if (input_connectors[0]->is_empty_buffer())
+		return; // Empty -> nothing to do
+
+	size_t n = end - begin;
 	FFTBuf &amplitude_buf = input_connectors[0]->get_buffer();
 	if (input_connectors[1]->is_empty_buffer()) {
 		if (!amplitude_buf.is_complex())
 			return; // Simply copy -> nothing to do
 
 		// Extract amplitudes
-		std::complex<double> *in = amplitude_buf.get_complex_data();
-		double *out = output_buffers[0].get_real_data();
-		for (size_t i = 0; i < n; ++i) {
-			std::complex<double> c = *in++;
-			*out++ = std::abs(c);
-		}
-		double max_norm = amplitude_buf.get_max_norm();
-		output_buffers[0].set_extremes(Extremes(max_norm));
+		std::complex<double> *in = amplitude_buf.get_complex_range(begin);
+		double *out = output_buffers[0].get_real_range(begin);
+		abs_data(n, in, out, MathAccuracy::fast);
 		return;
 	}
 
 	// Both buffers are non-empty - we have to consider four cases
 	// (each buffer can be real or complex)
 	FFTBuf &phase_buf = input_connectors[1]->get_buffer();
-	std::complex<double> *out = output_buffers[0].get_complex_data();
-	output_buffers[0].set_extremes(amplitude_buf.get_extremes());
+	std::complex<double> *out = output_buffers[0].get_complex_range(begin);
 
 	if (amplitude_buf.is_complex()) {
-		std::complex<double> *amplitude_in = amplitude_buf.get_complex_data();
+		std::complex<double> *amplitude_in = amplitude_buf.get_complex_range(begin);
 		if (phase_buf.is_complex()) {
 			// Complex amplitudes, complex phases
-			std::complex<double> *phase_in = phase_buf.get_complex_data();
-			for (size_t i = 0; i < n; ++i) {
-				double amp = std::abs(*amplitude_in++);
-				double phase = std::arg(*phase_in++);
-				std::complex<double> d = std::polar(amp, phase);
-				*out++ = d;
-			}
+			std::complex<double> *phase_in = phase_buf.get_complex_range(begin);
+			polar_data(n, amplitude_in, phase_in, out, MathAccuracy::fast);
 		} else {
 			// Complex amplitudes, real phases
-			double *phase_in = phase_buf.get_real_data();
-			for (size_t i = 0; i < n; ++i) {
-				double amp = std::abs(*amplitude_in++);
-				double phase = *phase_in++ * M_PI;
-				std::complex<double> d = std::polar(amp, phase);
-				*out++ = d;
-			}
+			double *phase_in = phase_buf.get_real_range(begin);
+			polar_data(n, amplitude_in, phase_in, M_PI, out, MathAccuracy::fast);
 		}
 	} else {
-		double *amplitude_in = amplitude_buf.get_real_data();
+		double *amplitude_in = amplitude_buf.get_real_range(begin);
 		if (phase_buf.is_complex()) {
 			// Real amplitudes, complex phases
-			std::complex<double> *phase_in = phase_buf.get_complex_data();
-			for (size_t i = 0; i < n; ++i) {
-				double amp = *amplitude_in++;
-				double phase = std::arg(*phase_in++);
-				std::complex<double> d = std::polar(amp, phase);
-				*out++ = d;
-			}
+			std::complex<double> *phase_in = phase_buf.get_complex_range(begin);
+			polar_data(n, amplitude_in, phase_in, out, MathAccuracy::fast);
 		} else {
 			// Real amplitudes, real phases
-			double *phase_in = phase_buf.get_real_data();
-			for (size_t i = 0; i < n; ++i) {
-				double amp = *amplitude_in++;
-				double phase = *phase_in++ * M_PI;
-				std::complex<double> d = std::polar(amp, phase);
-				*out++ = d;
-			}
+			double *phase_in = phase_buf.get_real_range(begin);
+			polar_data(n, amplitude_in, phase_in, M_PI, out, MathAccuracy::fast);
 		}
 	}
 }
 
-void OperatorMerge::execute()
+void OperatorMerge::execute_finish()
 {
 	if (input_connectors[0]->is_empty_buffer())
 		return; // Empty -> nothing to do
 
-	dispatch_calculate(*this);
+	FFTBuf &amplitude_buf = input_connectors[0]->get_buffer();
+	if (input_connectors[1]->is_empty_buffer() && !amplitude_buf.is_complex())
+		return; // Simply copy -> nothing to do
+
+	// In all other cases, the magnitudes are those of the amplitude buffer
+	output_buffers[0].set_extremes(amplitude_buf.get_extremes());
 }
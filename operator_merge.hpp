@@ -8,15 +8,15 @@ class OperatorMerge : public OperatorNoState<OperatorId::Merge, 2, 1>
 {
 	bool input_connection_changed() override;
 	void execute() override;
+	bool is_pointwise() const override;
+	void execute_range(size_t begin, size_t end) override;
+	void execute_finish() override;
 public:
 	inline static constexpr const char *icon = ":/icons/merge.svg";
 	inline static constexpr const char *tooltip = "Add Merge";
 
 	using OperatorNoState::OperatorNoState;
 	void init() override;
-private:
-	friend class Operator;
-	template<size_t N> void calculate();
 };
 
 #endif
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "operator_mult.hpp"
+#include "operator_const.hpp"
 #include "document.hpp"
 #include "transform_data.hpp"
 
@@ -9,16 +10,38 @@ bool OperatorMult::input_connection_changed()
 	bool is_empty1 = input_connectors[1]->is_empty_buffer();
 
 	// Empty if either input buffer is empty.
+	set_shortcut(false);
 	if (is_empty0 || is_empty1)
 		return make_output_empty(0);
 
+	// Multiplication by the constant 1 is the identity function.
+	// Only forward complex buffers, since the output of a
+	// multiplication with a constant is always complex.
+	for (size_t i = 0; i < 2; ++i) {
+		auto c = dynamic_cast<OperatorConst *>(get_input_operator(i));
+		FFTBuf &other = input_connectors[1 - i]->get_buffer();
+		if (c && c->is_one() && other.is_complex()) {
+			set_shortcut(true);
+			return make_output_forwarded(0, other);
+		}
+	}
+
+	// Symmetries common to both inputs are preserved.
+	Symmetry symmetry = input_connectors[0]->get_buffer().get_symmetry() &
+			    input_connectors[1]->get_buffer().get_symmetry();
+
 	// Real if both input buffers are real.
 	if (!input_connectors[0]->get_buffer().is_complex() &&
 	   !input_connectors[1]->get_buffer().is_complex())
-		return make_output_real(0);
+		return make_output_real(0, symmetry);
 
 	// Complex, because at least one is complex.
-	return make_output_complex(0);
+	return make_output_complex(0, symmetry);
+}
+
+bool OperatorMult::shortcut_depends_on(const Operator &parent) const
+{
+	return dynamic_cast<const OperatorConst *>(&parent) != nullptr;
 }
 
 void OperatorMult::init()
@@ -34,35 +57,54 @@ static T3 mult(T1 d1, T2 d2)
 
 void OperatorMult::execute()
 {
-	if (input_connectors[0]->is_empty_buffer() || input_connectors[1]->is_empty_buffer())
+	execute_pointwise();
+}
+
+bool OperatorMult::is_pointwise() const
+{
+	return true;
+}
+
+void OperatorMult::execute_range(size_t begin, size_t end)
+{
+	if (input_connectors[0]->is_empty_buffer() || input_connectors[1]->is_empty_buffer() ||
+	    output_buffers[0].is_forwarded())
 		return; // Empty or copy -> nothing to do
 
 	FFTBuf &buf1 = input_connectors[0]->get_buffer();
 	FFTBuf &buf2 = input_connectors[1]->get_buffer();
 	FFTBuf &buf_out = output_buffers[0];
 
-	size_t N = get_fft_size();
 	if (!buf1.is_complex() && !buf2.is_complex()) {
 		// Add reals
-		transform_data<double, double, double>
-			(N, buf1,  buf2, buf_out,
+		transform_data_range<double, double, double>
+			(begin, end, buf1, buf2, buf_out,
 			mult<double, double, double>);
 	} else if (buf1.is_complex() && !buf2.is_complex()) {
 		// Add complex to real
-		transform_data<std::complex<double>, double, std::complex<double>>
-			(N, buf1, buf2, buf_out,
+		transform_data_range<std::complex<double>, double, std::complex<double>>
+			(begin, end, buf1, buf2, buf_out,
 			mult<std::complex<double>, double, std::complex<double>>);
 	} else if (!buf1.is_complex() && buf2.is_complex()) {
 		// Add real to complex
-		transform_data<double, std::complex<double>, std::complex<double>>
-			(N, buf1, buf2, buf_out,
+		transform_data_range<double, std::complex<double>, std::complex<double>>
+			(begin, end, buf1, buf2, buf_out,
 			mult<double, std::complex<double>, std::complex<double>>);
 	} else {
 		// Add complex values
-		transform_data<std::complex<double>, std::complex<double>, std::complex<double>>
-			(N, buf1, buf2, buf_out,
+		transform_data_range<std::complex<double>, std::complex<double>, std::complex<double>>
+			(begin, end, buf1, buf2, buf_out,
 			mult<std::complex<double>, std::complex<double>, std::complex<double>>);
 	}
+}
 
+void OperatorMult::execute_finish()
+{
+	if (input_connectors[0]->is_empty_buffer() || input_connectors[1]->is_empty_buffer() ||
+	    output_buffers[0].is_forwarded())
+		return; // Empty or copy -> nothing to do
+
+	FFTBuf &buf1 = input_connectors[0]->get_buffer();
+	FFTBuf &buf2 = input_connectors[1]->get_buffer();
 	output_buffers[0].set_extremes(buf1.get_extremes() * buf2.get_extremes());
 }
@@ -8,6 +8,10 @@ class OperatorMult : public OperatorNoState<OperatorId::Mult, 2, 1>
 {
 	bool input_connection_changed() override;
 	void execute() override;
+	bool is_pointwise() const override;
+	void execute_range(size_t begin, size_t end) override;
+	void execute_finish() override;
+	bool shortcut_depends_on(const Operator &parent) const override;
 public:
 	inline static constexpr const char *icon = ":/icons/mult.svg";
 	inline static constexpr const char *tooltip = "Add Multiplication";
@@ -2,6 +2,7 @@
 #include "operator_pixmap.hpp"
 #include "document.hpp"
 #include "globals.hpp"
+#include "image_delta.hpp"
 #include "scramble.hpp"
 
 #include <QFileDialog>
@@ -11,6 +12,7 @@
 #include <QIcon>
 #include <QGraphicsSceneMouseEvent>
 
+#include <algorithm>
 #include <cassert>
 
 void OperatorPixmapState::init(size_t n_)
@@ -29,7 +31,7 @@ OperatorPixmap::OperatorPixmap(MainWindow &w)
 
 void OperatorPixmap::init()
 {
-	setPixmap(QPixmap::fromImage(state.image));
+	show_image(state.image);
 
 	new Button(":/icons/open.svg", "Load pixmap", [this](){ load_file(); }, Side::left, this);
 	new Button(":/icons/reset.svg", "Clear", [this](){ clear(); }, Side::left, this);
@@ -50,24 +52,51 @@ QJsonObject OperatorPixmapState::to_json() const
 
 void OperatorPixmapState::from_json(const QJsonObject &desc)
 {
-	QString encoded = desc["data"].toString();
-	if (encoded.isEmpty()) {
-		image.fill(0);
-	} else {
-		QByteArray array = QByteArray::fromBase64(encoded.toLatin1());
-		const unsigned char *data = reinterpret_cast<const unsigned char *>(array.data());
-		unsigned char *bits = image.bits();
-		for (size_t i = 0; i < n*n; ++i) {
-			*bits++ = *data++;
-		}
-	}
+	// In binary documents, the data is not a string but a chunk, see set_binary_field()
+	set_binary_field("data", QByteArray::fromBase64(desc["data"].toString().toLatin1()));
 	brush_size = desc["brush_size"].toInt();
 	antialiasing = desc["antialiasing"].toBool();
 }
 
+size_t OperatorPixmapState::payload_size() const
+{
+	return image.isNull() ? 0 : n*n;
+}
+
+QByteArray OperatorPixmapState::take_payload()
+{
+	QByteArray res(reinterpret_cast<const char *>(image.constBits()), n*n);
+	image = QImage();
+	return res;
+}
+
+void OperatorPixmapState::restore_payload(const QByteArray &data)
+{
+	image = QImage(n, n, QImage::Format_Grayscale8);
+	if (static_cast<size_t>(data.size()) != n*n) {
+		image.fill(0); // Reading back failed. Don't crash, at least.
+		return;
+	}
+	std::copy(data.begin(), data.end(), reinterpret_cast<char *>(image.bits()));
+}
+
+std::vector<const char *> OperatorPixmapState::binary_fields() const
+{
+	return { "data" };
+}
+
+void OperatorPixmapState::set_binary_field(const char *, const QByteArray &data)
+{
+	if (static_cast<size_t>(data.size()) != n*n) {
+		image.fill(0);
+		return;
+	}
+	std::copy(data.begin(), data.end(), reinterpret_cast<char *>(image.bits()));
+}
+
 void OperatorPixmap::state_reset()
 {
-	setPixmap(QPixmap::fromImage(state.image));
+	show_image(state.image);
 	brush_menu->set_pixmap(state.brush_size, state.antialiasing);
 	update_buffers();
 }
@@ -134,12 +163,20 @@ bool OperatorPixmap::handle_click(QGraphicsSceneMouseEvent *event)
 	return true;
 }
 
+// Paint directly into the image and only save the tiles that are painted on
+// for undo. Cloning the state would copy the whole image on every mouse move.
 void OperatorPixmap::drag_handle(const QPointF &p, Qt::KeyboardModifiers)
 {
-	auto new_state = clone_state();
 	QPoint next_pos = p.toPoint();
-	painter.begin(&new_state->image);
-	painter.setRenderHint(QPainter::Antialiasing, new_state->antialiasing);
+
+	// Add a margin for the round caps and antialiasing
+	int margin = state.brush_size / 2 + 2;
+	QRect rect = QRect(pos, next_pos).normalized().adjusted(-margin, -margin, margin, margin);
+	ImageDelta delta;
+	delta.save(state.image, rect);
+
+	painter.begin(&state.image);
+	painter.setRenderHint(QPainter::Antialiasing, state.antialiasing);
 	painter.setPen(pen);
 	// Qt has a strange bug(?) whereby drawLine doesn't degenerate to a single point for some brushes.
 	if (pos == next_pos)
@@ -148,9 +185,16 @@ void OperatorPixmap::drag_handle(const QPointF &p, Qt::KeyboardModifiers)
 		painter.drawLine(pos, next_pos);
 	painter.end();
 	pos = next_pos;
-	place_set_state_command("Draw on pixmap", std::move(new_state), !dont_accumulate_undo);
+	place_draw_command("Draw on pixmap", std::move(delta), !dont_accumulate_undo);
 
 	dont_accumulate_undo = false;
+	update_buffers(rect);
+}
+
+void OperatorPixmap::swap_image_delta(ImageDelta &delta)
+{
+	delta.swap(state.image);
+	update_buffers();
 }
 
 void OperatorPixmap::restore_handles()
@@ -158,6 +202,31 @@ void OperatorPixmap::restore_handles()
 	dont_accumulate_undo = true;
 }
 
+// A stroke doesn't snapshot the state, since that would copy the whole image.
+// The draw commands of a stroke are merged into one command on the undo stack.
+void OperatorPixmap::save_state()
+{
+	dont_accumulate_undo = true;
+}
+
+void OperatorPixmap::commit_state()
+{
+}
+
+// Cancelled stroke: swap the painted tiles back and remove the command.
+void OperatorPixmap::restore_state()
+{
+	if (dont_accumulate_undo)
+		return;
+	get_document().discard_last_command();
+	dont_accumulate_undo = true;
+}
+
+bool OperatorPixmap::has_local_changes() const
+{
+	return true;
+}
+
 template<size_t N>
 void OperatorPixmap::calculate()
 {
@@ -167,12 +236,30 @@ void OperatorPixmap::calculate()
 		(in, out, [](unsigned char c) { return static_cast<double>(c) / 255.0; });
 }
 
-void OperatorPixmap::update_buffers()
+// Copy only the painted region into the scrambled buffer
+void OperatorPixmap::calculate_rect(const QRect &rect)
 {
-	dispatch_calculate(*this);
+	size_t n = get_fft_size();
+	size_t mask = n - 1;
+	QRect r = rect.intersected(state.image.rect());
+	double *out = output_buffers[0].get_real_data();
+	for (int y = r.top(); y <= r.bottom(); ++y) {
+		const unsigned char *in = state.image.constScanLine(y);
+		double *line = out + ((y + n / 2) & mask) * n;
+		for (int x = r.left(); x <= r.right(); ++x)
+			line[(x + n / 2) & mask] = static_cast<double>(in[x]) / 255.0;
+	}
+}
+
+void OperatorPixmap::update_buffers(const QRect &changed)
+{
+	if (changed.isNull())
+		dispatch_calculate(*this);
+	else
+		calculate_rect(changed);
 	output_buffers[0].set_extremes(Extremes(1.0));
 
-	setPixmap(QPixmap::fromImage(state.image));
+	show_image(state.image, changed);
 
 	// Execute children
 	execute_topo();
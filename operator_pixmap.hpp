@@ -12,6 +12,11 @@
 class OperatorPixmapState final : public Operator::StateTemplate<OperatorPixmapState> {
 	QJsonObject to_json() const override;
 	void from_json(const QJsonObject &) override;
+	size_t payload_size() const override;
+	QByteArray take_payload() override;
+	void restore_payload(const QByteArray &) override;
+	std::vector<const char *> binary_fields() const override;
+	void set_binary_field(const char *field, const QByteArray &data) override;
 	size_t n; // Set once at initialization
 public:
 	void init(size_t n);
@@ -26,7 +31,7 @@ class OperatorPixmap : public OperatorTemplate<OperatorId::Pixmap, OperatorPixma
 	void load_file();
 	void clear();
 	void invert();
-	void update_buffers();
+	void update_buffers(const QRect &changed = QRect());	// changed: painted region, null for everything
 
 	void init() override;
 	void placed() override;
@@ -35,11 +40,16 @@ class OperatorPixmap : public OperatorTemplate<OperatorId::Pixmap, OperatorPixma
 	bool handle_click(QGraphicsSceneMouseEvent *event) override;
 	void drag_handle(const QPointF &p, Qt::KeyboardModifiers) override;
 	void restore_handles() override; // Tells us that we exited from drag mode
+	void save_state() override;
+	void restore_state() override;
+	void commit_state() override;
+	void swap_image_delta(ImageDelta &delta) override;
+	bool has_local_changes() const override;
 
 	QPainter painter;
 	QPen pen;
 	QPoint pos;
-	bool dont_accumulate_undo;
+	bool dont_accumulate_undo;	// True until the first draw command of a stroke was placed
 
 	// Switch between pens
 	MenuButton *brush_menu;
@@ -52,6 +62,7 @@ public:
 private:
 	friend class Operator;
 	template<size_t N> void calculate();
+	void calculate_rect(const QRect &rect);
 };
 
 #endif
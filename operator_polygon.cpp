@@ -386,7 +386,7 @@ void OperatorPolygon::paint_polygon()
 
 		// QPolygon::intersected() closes the polygon, so let's remove the last point.
 		if (poly_trans.size() < 1) {
-			setPixmap(QPixmap::fromImage(image));
+			show_image(image);
 			return;
 		}
 		poly_trans.pop_back();
@@ -404,7 +404,7 @@ void OperatorPolygon::paint_polygon()
 			break;
 		}
 	}
-	setPixmap(QPixmap::fromImage(image));
+	show_image(image);
 }
 
 template<size_t N>
@@ -418,9 +418,35 @@ void OperatorPolygon::calculate()
 		{ return static_cast<double>(c) / 255.0; });
 }
 
+// True if the painted shape is not clipped at the border.
+// Must be called after paint_polygon(), which calculates the transformation.
+bool OperatorPolygon::is_inside() const
+{
+	size_t n = get_fft_size();
+	QRectF rect = state.mode == 0 ? trans.mapRect(QRectF(-1.5, -1.5, 3.0, 3.0))
+				      : trans.map(poly).boundingRect();
+	return QRectF(1.0, 1.0, n - 3.0, n - 3.0).contains(rect);
+}
+
 void OperatorPolygon::update_buffer()
 {
+	// The offset is integer, thus moving an unclipped shape only translates the output.
+	bool inside = is_inside();
+	bool translated = get_output_content().id != 0 && inside && calculated_inside &&
+			  state.mode == calculated_state.mode &&
+			  state.draw_mode == calculated_state.draw_mode &&
+			  state.width == calculated_state.width &&
+			  state.height == calculated_state.height &&
+			  state.rotation == calculated_state.rotation;
+
 	dispatch_calculate(*this);
+	set_output_origin(state.offset, !translated);
+	calculated_state = state;
+	calculated_inside = inside;
+
+	// E.g. polygons with an even number of vertices at the origin are centrosymmetric
+	if (update_output_symmetry(0))
+		output_buffer_changed();
 
 	// Execute children
 	execute_topo();
@@ -99,6 +99,11 @@ class OperatorPolygon : public OperatorTemplate<OperatorId::Polygon, OperatorPol
 
 	// Update FFT-buffer and children
 	void update_buffer();
+
+	// State of the last calculation, to detect if the output was only translated.
+	OperatorPolygonState calculated_state;
+	bool calculated_inside = false;
+	bool is_inside() const;
 	void placed() override;
 	void state_reset() override;
 
@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "operator_pow.hpp"
 #include "document.hpp"
+#include "complex_math.hpp"
+
+#include <algorithm>
 
 bool OperatorPow::input_connection_changed()
 {
@@ -39,15 +42,16 @@ static int get_pixmap_id(int exponent)
 	}
 }
 
-static double get_exponent(int exponent)
+// Returns numerator and denominator of the exponent
+static std::pair<int, int> get_exponent(int exponent)
 {
 	switch (exponent) {
-	case -3: return 1.0 / 3.0;
-	case -2: return 1.0 / 2.0;
-	case -1: return -1;
-	case 2: return 2.0;
-	case 3: return 3.0;
-	default: return 1.0;
+	case -3: return { 1, 3 };
+	case -2: return { 1, 2 };
+	case -1: return { -1, 1 };
+	case 2: return { 2, 1 };
+	case 3: return { 3, 1 };
+	default: return { 1, 1 };
 	};
 }
 
@@ -97,10 +101,8 @@ void OperatorPow::state_reset()
 {
 	menu->set_pixmap(get_pixmap_id(state.exponent));
 	setPixmap(get_pixmap(state.exponent, simple_size));
-	execute();
-
-	// Execute children
-	execute_topo();
+	// Execute this operator and its children, if they are needed
+	execute_topo(true);
 }
 
 Operator::InitState OperatorPow::make_init_state(int exponent)
@@ -136,13 +138,13 @@ void OperatorPow::set_exponent(int v)
 
 static constexpr double inverse_min = 0.000001;
 
-template <typename T, size_t N>
-static double inverse_doit(FFTBuf &in_buf, FFTBuf &out_buf)
+template <typename T>
+static double inverse_doit(size_t begin, size_t end, FFTBuf &in_buf, FFTBuf &out_buf)
 {
-	T *in = in_buf.get_data<T>();
-	T *out = out_buf.get_data<T>();
+	T *in = in_buf.get_range_data<T>(begin);
+	T *out = out_buf.get_range_data<T>(begin);
 	double max_norm = 0.0;
-	for (size_t i = 0; i < N*N; ++i) {
+	for (size_t i = begin; i < end; ++i) {
 		T x = *in++;
 		x = std::abs(x) < inverse_min ? 1.0 / inverse_min : 1.0 / x;
 		double norm = std::norm(x);
@@ -153,45 +155,54 @@ static double inverse_doit(FFTBuf &in_buf, FFTBuf &out_buf)
 	return max_norm;
 }
 
-template <typename T, size_t N>
-static void pow_doit(FFTBuf &in_buf, FFTBuf &out_buf, double exponent)
+void OperatorPow::execute()
 {
-	T *in = in_buf.get_data<T>();
-	T *out = out_buf.get_data<T>();
-	for (size_t i = 0; i < N*N; ++i)
-		*out++ = pow(*in++, exponent);
+	execute_pointwise();
 }
 
-template<size_t N>
-void OperatorPow::calculate()
+bool OperatorPow::is_pointwise() const
 {
+	return true;
+}
+
+void OperatorPow::execute_range(size_t begin, size_t end)
+{
+	if (input_connectors[0]->is_empty_buffer())
+		return; // Empty -> nothing to do
+
 	FFTBuf &buf = input_connectors[0]->get_buffer();
 	FFTBuf &out = output_buffers[0];
 
 	// Hardcode the inverse instead of using the pow() function
-	double max_norm;
 	if (state.exponent == -1) {
-		if (buf.is_complex())
-			max_norm = inverse_doit<std::complex<double>, N>(buf, out);
-		else
-			max_norm = inverse_doit<double, N>(buf, out);
+		double max_norm = buf.is_complex() ? inverse_doit<std::complex<double>>(begin, end, buf, out)
+						   : inverse_doit<double>(begin, end, buf, out);
+		inverse_max_norm = std::max(inverse_max_norm, max_norm);
 	} else {
-		double exponent = get_exponent(state.exponent);
+		auto [numerator, denominator] = get_exponent(state.exponent);
+		size_t n = end - begin;
 		if (buf.is_complex())
-			pow_doit<std::complex<double>, N>(buf, out, exponent);
+			pow_data(n, buf.get_complex_range(begin), out.get_complex_range(begin),
+				 numerator, denominator, MathAccuracy::fast);
 		else
-			pow_doit<double, N>(buf, out, exponent);
-
-		max_norm = pow(buf.get_extremes().get_max_norm(), exponent);
+			pow_data(n, buf.get_real_range(begin), out.get_real_range(begin),
+				 numerator, denominator, MathAccuracy::fast);
 	}
-	output_buffers[0].set_extremes(Extremes(max_norm));
-
 }
 
-void OperatorPow::execute()
+void OperatorPow::execute_finish()
 {
 	if (input_connectors[0]->is_empty_buffer())
 		return; // Empty -> nothing to do
 
-	dispatch_calculate(*this);
+	double max_norm;
+	if (state.exponent == -1) {
+		max_norm = inverse_max_norm;
+		inverse_max_norm = 0.0;
+	} else {
+		auto [numerator, denominator] = get_exponent(state.exponent);
+		FFTBuf &buf = input_connectors[0]->get_buffer();
+		max_norm = pow(buf.get_extremes().get_max_norm(), double(numerator) / denominator);
+	}
+	output_buffers[0].set_extremes(Extremes(max_norm));
 }
@@ -23,6 +23,12 @@ class OperatorPow : public OperatorTemplate<OperatorId::Pow, OperatorPowState, 1
 
 	bool input_connection_changed() override;
 	void execute() override;
+	bool is_pointwise() const override;
+	void execute_range(size_t begin, size_t end) override;
+	void execute_finish() override;
+
+	// The maximum norm of the inverse is collected over all ranges
+	double inverse_max_norm = 0.0;
 
 	MenuButton *menu;
 	void set_exponent(int exponent);
@@ -36,9 +42,6 @@ public:
 
 	using OperatorTemplate::OperatorTemplate;
 	void init() override;
-private:
-	friend class Operator;
-	template<size_t N> void calculate();
 };
 
 #endif
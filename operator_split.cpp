@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "operator_split.hpp"
 #include "document.hpp"
+#include "complex_math.hpp"
 
 void OperatorSplit::init()
 {
@@ -36,6 +37,16 @@ bool OperatorSplit::input_connection_changed()
 }
 
 void OperatorSplit::execute()
+{
+	execute_pointwise();
+}
+
+bool OperatorSplit::is_pointwise() const
+{
+	return true;
+}
+
+void OperatorSplit::execute_range(size_t begin, size_t end)
 {
 	if (input_connectors[0]->is_empty_buffer())
 		return; // Empty -> nothing to do
@@ -46,18 +57,19 @@ void OperatorSplit::execute()
 		return;
 	}
 
-	size_t fft_size = get_fft_size();
-	size_t n = fft_size * fft_size;
-	std::complex<double> *in = buf.get_complex_data();
-	double *out_amplitudes = output_buffers[0].get_real_data();
-	double *out_phases = output_buffers[1].get_real_data();
+	std::complex<double> *in = buf.get_complex_range(begin);
+	double *out_amplitudes = output_buffers[0].get_real_range(begin);
+	double *out_phases = output_buffers[1].get_real_range(begin);
 
-	for (size_t i = 0; i < n; ++i) {
-		std::complex<double> c = *in++;
-		*out_amplitudes++ = std::abs(c);
-		*out_phases++ = std::arg(c) / M_PI;
-	}
+	abs_arg_data(end - begin, in, out_amplitudes, out_phases, 1.0 / M_PI, MathAccuracy::fast);
+}
+
+void OperatorSplit::execute_finish()
+{
+	if (input_connectors[0]->is_empty_buffer() ||
+	    !input_connectors[0]->get_buffer().is_complex())
+		return; // Empty or real -> nothing to do
 
-	output_buffers[0].set_extremes(buf.get_extremes());
+	output_buffers[0].set_extremes(input_connectors[0]->get_buffer().get_extremes());
 	output_buffers[1].set_extremes(Extremes(1.0));
 }
@@ -8,6 +8,9 @@ class OperatorSplit : public OperatorNoState<OperatorId::Split, 1, 2>
 {
 	bool input_connection_changed() override;
 	void execute() override;
+	bool is_pointwise() const override;
+	void execute_range(size_t begin, size_t end) override;
+	void execute_finish() override;
 public:
 	inline static constexpr const char *icon = ":/icons/split.svg";
 	inline static constexpr const char *tooltip = "Add Split";
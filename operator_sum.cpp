@@ -23,13 +23,17 @@ bool OperatorSum::input_connection_changed()
 	if (is_empty1)
 		return make_output_forwarded(0, input_connectors[0]->get_buffer());
 
+	// Symmetries common to both inputs are preserved.
+	Symmetry symmetry = input_connectors[0]->get_buffer().get_symmetry() &
+			    input_connectors[1]->get_buffer().get_symmetry();
+
 	// Real if both input buffers are real.
 	if (!input_connectors[0]->get_buffer().is_complex() &&
 	   !input_connectors[1]->get_buffer().is_complex())
-		return make_output_real(0);
+		return make_output_real(0, symmetry);
 
 	// Complex, because at least one is complex.
-	return make_output_complex(0);
+	return make_output_complex(0, symmetry);
 }
 template <typename T1, typename T2, typename T3>
 static T3 sum(T1 d1, T2 d2)
@@ -38,6 +42,16 @@ static T3 sum(T1 d1, T2 d2)
 }
 
 void OperatorSum::execute()
+{
+	execute_pointwise();
+}
+
+bool OperatorSum::is_pointwise() const
+{
+	return true;
+}
+
+void OperatorSum::execute_range(size_t begin, size_t end)
 {
 	if (input_connectors[0]->is_empty_buffer() || input_connectors[1]->is_empty_buffer())
 		return; // Empty or copy -> nothing to do
@@ -46,28 +60,35 @@ void OperatorSum::execute()
 	FFTBuf &buf2 = input_connectors[1]->get_buffer();
 	FFTBuf &buf_out = output_buffers[0];
 
-	size_t N = get_fft_size();
 	if (!buf1.is_complex() && !buf2.is_complex()) {
 		// Add reals
-		transform_data<double, double, double>
-			(N, buf1, buf2, buf_out,
+		transform_data_range<double, double, double>
+			(begin, end, buf1, buf2, buf_out,
 			sum<double, double, double>);
 	} else if (buf1.is_complex() && !buf2.is_complex()) {
 		// Add complex to real
-		transform_data<std::complex<double>, double, std::complex<double>>
-			(N, buf1, buf2, buf_out,
+		transform_data_range<std::complex<double>, double, std::complex<double>>
+			(begin, end, buf1, buf2, buf_out,
 			sum<std::complex<double>, double, std::complex<double>>);
 	} else if (!buf1.is_complex() && buf2.is_complex()) {
 		// Add real to complex
-		transform_data<double, std::complex<double>, std::complex<double>>
-			(N, buf1, buf2, buf_out,
+		transform_data_range<double, std::complex<double>, std::complex<double>>
+			(begin, end, buf1, buf2, buf_out,
 			sum<double, std::complex<double>, std::complex<double>>);
 	} else {
 		// Add complex values
-		transform_data<std::complex<double>, std::complex<double>, std::complex<double>>
-			(N, buf1, buf2, buf_out,
+		transform_data_range<std::complex<double>, std::complex<double>, std::complex<double>>
+			(begin, end, buf1, buf2, buf_out,
 			sum<std::complex<double>, std::complex<double>, std::complex<double>>);
 	}
+}
 
+void OperatorSum::execute_finish()
+{
+	if (input_connectors[0]->is_empty_buffer() || input_connectors[1]->is_empty_buffer())
+		return; // Empty or copy -> nothing to do
+
+	FFTBuf &buf1 = input_connectors[0]->get_buffer();
+	FFTBuf &buf2 = input_connectors[1]->get_buffer();
 	output_buffers[0].set_extremes(buf1.get_extremes() + buf2.get_extremes());
 }
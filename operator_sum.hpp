@@ -8,6 +8,9 @@ class OperatorSum : public OperatorNoState<OperatorId::Sum, 2, 1>
 {
 	bool input_connection_changed() override;
 	void execute() override;
+	bool is_pointwise() const override;
+	void execute_range(size_t begin, size_t end) override;
+	void execute_finish() override;
 	void init() override;
 public:
 	inline static constexpr const char *icon = ":/icons/sum.svg";
@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "operator_symmetrize.hpp"
+#include "document.hpp"
+#include "aligned_buf.hpp"	// For assume_aligned
+
+#include <algorithm>
+
+bool OperatorSymmetrize::input_connection_changed()
+{
+	// Empty if the input buffer is empty.
+	if (input_connectors[0]->is_empty_buffer())
+		return make_output_empty(0);
+
+	FFTBuf &buf = input_connectors[0]->get_buffer();
+	if (buf.is_complex())
+		return make_output_complex(0);
+	else
+		return make_output_real(0);
+}
+
+const char *OperatorSymmetrize::get_pixmap_name(OperatorSymmetrizeGroup group)
+{
+	switch (group) {
+	case OperatorSymmetrizeGroup::two: return ":icons/inversion.svg";
+	case OperatorSymmetrizeGroup::four: return ":icons/4+.svg";
+	case OperatorSymmetrizeGroup::m: return ":icons/m_x.svg";
+	case OperatorSymmetrizeGroup::mm2: return ":icons/mm2.svg";
+	default:
+	case OperatorSymmetrizeGroup::four_mm: return ":icons/4mm.svg";
+	}
+}
+
+const char *OperatorSymmetrize::get_tooltip(OperatorSymmetrizeGroup group)
+{
+	switch (group) {
+	case OperatorSymmetrizeGroup::two: return "Symmetrize by twofold rotation (2)";
+	case OperatorSymmetrizeGroup::four: return "Symmetrize by fourfold rotation (4)";
+	case OperatorSymmetrizeGroup::m: return "Symmetrize by reflection at x=0 (m)";
+	case OperatorSymmetrizeGroup::mm2: return "Symmetrize by reflections at x=0 and y=0 (mm2)";
+	default:
+	case OperatorSymmetrizeGroup::four_mm: return "Symmetrize by fourfold rotation and reflections (4mm)";
+	}
+}
+
+QPixmap OperatorSymmetrize::get_pixmap(OperatorSymmetrizeGroup group, int size)
+{
+	const char *name = get_pixmap_name(group);
+	return QIcon(name).pixmap(QSize(size, size));
+}
+
+void OperatorSymmetrize::init()
+{
+	setPixmap(get_pixmap(state.group, simple_size));
+
+	menu = new MenuButton(Side::left, "Set point group", this);
+	menu->add_entry(get_pixmap(OperatorSymmetrizeGroup::two, default_button_height),
+			get_tooltip(OperatorSymmetrizeGroup::two), [this](){ set_group(OperatorSymmetrizeGroup::two); });
+	menu->add_entry(get_pixmap(OperatorSymmetrizeGroup::four, default_button_height),
+			get_tooltip(OperatorSymmetrizeGroup::four), [this](){ set_group(OperatorSymmetrizeGroup::four); });
+	menu->add_entry(get_pixmap(OperatorSymmetrizeGroup::m, default_button_height),
+			get_tooltip(OperatorSymmetrizeGroup::m), [this](){ set_group(OperatorSymmetrizeGroup::m); });
+	menu->add_entry(get_pixmap(OperatorSymmetrizeGroup::mm2, default_button_height),
+			get_tooltip(OperatorSymmetrizeGroup::mm2), [this](){ set_group(OperatorSymmetrizeGroup::mm2); });
+	menu->add_entry(get_pixmap(OperatorSymmetrizeGroup::four_mm, default_button_height),
+			get_tooltip(OperatorSymmetrizeGroup::four_mm), [this](){ set_group(OperatorSymmetrizeGroup::four_mm); });
+	menu->set_pixmap((int)state.group);
+}
+
+Operator::InitState OperatorSymmetrize::make_init_state(OperatorSymmetrizeGroup group)
+{
+	auto state = std::make_unique<OperatorSymmetrizeState>();
+	state->group = group;
+	return {
+		get_pixmap_name(group),
+		get_tooltip(group),
+		std::move(state)
+	};
+}
+
+std::vector<Operator::InitState> OperatorSymmetrize::get_init_states()
+{
+	std::vector<Operator::InitState> res;
+	res.push_back(make_init_state(OperatorSymmetrizeGroup::two));
+	res.push_back(make_init_state(OperatorSymmetrizeGroup::four));
+	res.push_back(make_init_state(OperatorSymmetrizeGroup::m));
+	res.push_back(make_init_state(OperatorSymmetrizeGroup::mm2));
+	res.push_back(make_init_state(OperatorSymmetrizeGroup::four_mm));
+	return res;
+}
+
+QJsonObject OperatorSymmetrizeState::to_json() const
+{
+	QJsonObject res;
+	res["group"] = static_cast<int>(group);
+	return res;
+}
+
+void OperatorSymmetrizeState::from_json(const QJsonObject &desc)
+{
+	group = static_cast<OperatorSymmetrizeGroup>(desc["group"].toInt());
+}
+
+void OperatorSymmetrize::state_reset()
+{
+	menu->set_pixmap((int)state.group);
+	setPixmap(get_pixmap(state.group, simple_size));
+
+	// Execute this operator and its children, if they are needed
+	execute_topo(true);
+}
+
+void OperatorSymmetrize::set_group(OperatorSymmetrizeGroup group)
+{
+	if (state.group == group)
+		return;
+	auto new_state = clone_state();
+	new_state->group = group;
+	place_set_state_command("Set point group", std::move(new_state), false);
+}
+
+// A symmetry operation of the square, using the same index mapping as the
+// reflect() and rotate() kernels of OperatorInversion: first optionally swap
+// x and y, then optionally flip the resulting coordinates (x -> N - 1 - x).
+struct SymmetryOperation {
+	bool swap;
+	bool flip_x;
+	bool flip_y;
+};
+
+template <size_t N>
+static inline size_t apply_operation(SymmetryOperation op, size_t x, size_t y)
+{
+	size_t a = op.swap ? y : x;
+	size_t b = op.swap ? x : y;
+	if (op.flip_x)
+		a = N - 1 - a;
+	if (op.flip_y)
+		b = N - 1 - b;
+	return b * N + a;
+}
+
+template <OperatorSymmetrizeGroup G>
+static constexpr auto get_operations()
+{
+	using Op = SymmetryOperation;
+	if constexpr (G == OperatorSymmetrizeGroup::two)
+		return std::array<Op, 2> {{ { false, false, false }, { false, true, true } }};
+	else if constexpr (G == OperatorSymmetrizeGroup::four)
+		return std::array<Op, 4> {{ { false, false, false }, { false, true, true },
+					    { true, true, false }, { true, false, true } }};
+	else if constexpr (G == OperatorSymmetrizeGroup::m)
+		return std::array<Op, 2> {{ { false, false, false }, { false, true, false } }};
+	else if constexpr (G == OperatorSymmetrizeGroup::mm2)
+		return std::array<Op, 4> {{ { false, false, false }, { false, true, false },
+					    { false, false, true }, { false, true, true } }};
+	else
+		return std::array<Op, 8> {{ { false, false, false }, { false, true, false },
+					    { false, false, true }, { false, true, true },
+					    { true, false, false }, { true, true, false },
+					    { true, false, true }, { true, true, true } }};
+}
+
+// Average over the orbits of the point group in a single pass:
+// Iterate over an asymmetric unit, sum the input at all positions of
+// the orbit and write the average back to all these positions.
+// Points on symmetry elements appear multiple times in their orbit,
+// which is harmless: they are summed with the correct multiplicity.
+// The asymmetric units are:
+//	2:	lower half
+//	m:	left half
+//	mm2, 4:	lower left quadrant
+//	4mm:	triangle x <= y of the lower left quadrant
+// As with rotate(), operations containing a swap read and write columns.
+// Therefore, process the asymmetric unit in tiles.
+template <typename T, size_t N, OperatorSymmetrizeGroup G>
+static Extremes symmetrize_group(const T *in, T *out)
+{
+	constexpr auto ops = get_operations<G>();
+	constexpr double factor = 1.0 / ops.size();
+	constexpr size_t tile_size = std::min(N / 2, 256 / sizeof(T));
+	constexpr size_t end_x = G == OperatorSymmetrizeGroup::two ? N : N / 2;
+	constexpr size_t end_y = G == OperatorSymmetrizeGroup::m ? N : N / 2;
+
+	Extremes extremes;
+	for (size_t tile_y = 0; tile_y < end_y; tile_y += tile_size) {
+		for (size_t tile_x = 0; tile_x < end_x; tile_x += tile_size) {
+			if (G == OperatorSymmetrizeGroup::four_mm && tile_x > tile_y)
+				continue;
+			for (size_t y = tile_y; y < tile_y + tile_size; ++y) {
+				size_t tile_end_x = tile_x + tile_size;
+				if (G == OperatorSymmetrizeGroup::four_mm)
+					tile_end_x = std::min(tile_end_x, y + 1);
+				for (size_t x = tile_x; x < tile_end_x; ++x) {
+					T sum = 0.0;
+					for (SymmetryOperation op: ops)
+						sum += in[apply_operation<N>(op, x, y)];
+					extremes.reg(sum, factor);
+					for (SymmetryOperation op: ops)
+						out[apply_operation<N>(op, x, y)] = sum;
+				}
+			}
+		}
+	}
+	return extremes;
+}
+
+template <typename T, size_t N>
+Extremes OperatorSymmetrize::symmetrize(FFTBuf &in_buf, FFTBuf &out_buf)
+{
+	const T *in = assume_aligned(in_buf.get_data<T>());
+	T *out = assume_aligned(out_buf.get_data<T>());
+	switch (state.group) {
+	case OperatorSymmetrizeGroup::two: return symmetrize_group<T,N,OperatorSymmetrizeGroup::two>(in, out);
+	case OperatorSymmetrizeGroup::four: return symmetrize_group<T,N,OperatorSymmetrizeGroup::four>(in, out);
+	case OperatorSymmetrizeGroup::m: return symmetrize_group<T,N,OperatorSymmetrizeGroup::m>(in, out);
+	case OperatorSymmetrizeGroup::mm2: return symmetrize_group<T,N,OperatorSymmetrizeGroup::mm2>(in, out);
+	default:
+	case OperatorSymmetrizeGroup::four_mm: return symmetrize_group<T,N,OperatorSymmetrizeGroup::four_mm>(in, out);
+	}
+}
+
+template<size_t N>
+void OperatorSymmetrize::calculate()
+{
+	FFTBuf &buf = input_connectors[0]->get_buffer();
+	FFTBuf &out = output_buffers[0];
+
+	// The maximum norm is collected while writing, so it is exact.
+	Extremes extremes = buf.is_complex() ? symmetrize<std::complex<double>, N>(buf, out)
+					     : symmetrize<double, N>(buf, out);
+	output_buffers[0].set_extremes(extremes);
+}
+
+void OperatorSymmetrize::execute()
+{
+	if (input_connectors[0]->is_empty_buffer())
+		return; // Empty -> nothing to do
+
+	dispatch_calculate(*this);
+}
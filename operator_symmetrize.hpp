@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef OPERATOR_SYMMETRIZE_HPP
+#define OPERATOR_SYMMETRIZE_HPP
+
+#include "operator.hpp"
+
+// Point groups in Hermann-Mauguin notation.
+// Note: 3- and 6-fold axes are not compatible with the square grid and are therefore not supported.
+enum class OperatorSymmetrizeGroup {
+	two,
+	four,
+	m,
+	mm2,
+	four_mm
+};
+
+class OperatorSymmetrizeState final : public Operator::StateTemplate<OperatorSymmetrizeState> {
+	QJsonObject to_json() const override;
+	void from_json(const QJsonObject &) override;
+public:
+	OperatorSymmetrizeGroup group = OperatorSymmetrizeGroup::four_mm;
+};
+
+class OperatorSymmetrize : public OperatorTemplate<OperatorId::Symmetrize, OperatorSymmetrizeState, 1, 1>
+{
+	static InitState make_init_state(OperatorSymmetrizeGroup group);
+	void state_reset() override;
+
+	bool input_connection_changed() override;
+	void execute() override;
+
+	MenuButton *menu;
+	void set_group(OperatorSymmetrizeGroup group);
+	static const char *get_pixmap_name(OperatorSymmetrizeGroup group);
+	static QPixmap get_pixmap(OperatorSymmetrizeGroup group, int size);
+	static const char *get_tooltip(OperatorSymmetrizeGroup group);
+public:
+	inline static constexpr const char *icon = ":/icons/4mm.svg";
+	inline static constexpr const char *tooltip = "Add symmetrization";
+	static std::vector<InitState> get_init_states();
+
+	using OperatorTemplate::OperatorTemplate;
+	void init() override;
+private:
+	friend class Operator;
+	template<size_t N> void calculate();
+	template <typename T, size_t N> Extremes symmetrize(FFTBuf &in_buf, FFTBuf &out_buf);
+};
+
+#endif
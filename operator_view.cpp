@@ -8,7 +8,14 @@
 #include <QGraphicsScene>
 #include <QMessageBox>
 
+#include <algorithm>
 #include <array>
+#include <type_traits>
+
+// Encoding of the cached planes. Magnitude code 0 means below min_magnitude (relative to the maximum).
+static constexpr double min_magnitude = 1e-16;
+static constexpr uint16_t max_magnitude_code = 65535;
+static constexpr uint16_t max_hue_code = 65535;
 
 // Minimum and maximum scales of the color modes
 // and whether the scroller is logrithmic.
@@ -63,13 +70,22 @@ void OperatorView::state_reset()
 	scroller->reset(desc.min, desc.max, desc.log_scroller, state.scale);
 	color_menu->set_pixmap(static_cast<int>(state.color_type));
 	mode_menu->set_pixmap(static_cast<int>(state.mode));
-	execute();
+	show_level(get_lod_level());
 }
 
 void OperatorView::init()
 {
 	size_t n = get_fft_size();
 	imagebuf = AlignedBuf<uint32_t>(n * n);
+	lod_levels.clear();
+	lod_num_levels = 0;
+	lod_level = 0;
+	magnitude_plane = AlignedBuf<uint16_t>(n * n);
+	phase_plane = AlignedBuf<uint16_t>(n * n);
+	planes_valid = false;
+	planes_complex = false;
+	intensity_table.resize(max_magnitude_code + 1);
+	intensity_table_valid = false;
 
 	dont_accumulate_undo = true;
 
@@ -98,19 +114,124 @@ void OperatorView::show_empty()
 	setPixmap(empty_pixmap);
 }
 
+// Log encoding of magnitudes relative to the maximum
+static const double log_min_magnitude = log(min_magnitude);
+static const double magnitude_code_factor = (max_magnitude_code - 1) / -log_min_magnitude;
+static constexpr double hue_code_factor = 1.0 / max_hue_code;
+
+static uint16_t encode_magnitude(double rel)
+{
+	if (!(rel > min_magnitude))
+		return 0;
+	double code = 1.0 + (log(rel) - log_min_magnitude) * magnitude_code_factor;
+	return static_cast<uint16_t>(std::min(code + 0.5, static_cast<double>(max_magnitude_code)));
+}
+
+static double decode_magnitude(uint16_t code)
+{
+	return code == 0 ? 0.0 : exp((code - 1) / magnitude_code_factor + log_min_magnitude);
+}
+
 template<size_t N, typename T>
-void OperatorView::calculate_doit()
+void OperatorView::calculate_planes()
 {
 	FFTBuf &buf = input_connectors[0]->get_buffer();
-	uint32_t *out = imagebuf.get();
-	double max = sqrt(buf.get_max_norm());
-	auto [factor1, factor2] = get_color_factors(state.mode, max, state.scale);
 	const T *in = buf.get_data<T>();
-	uint32_t (*fun)(T, double, double) = get_color_lookup_function<T>(state.color_type, state.mode);
+	double max = sqrt(buf.get_max_norm());
+	double inv_max = max > 0.0 ? 1.0 / max : 0.0;
+
+	scramble<N, T, uint16_t>
+		(in, magnitude_plane.get(), [inv_max](T c)
+		{ return encode_magnitude(std::abs(c) * inv_max); });
+	if constexpr (std::is_same_v<T, double>) {
+		scramble<N, T, uint16_t>
+			(in, phase_plane.get(), [](double v)
+			{ return static_cast<uint16_t>(v < 0.0 ? 1 : 0); });
+	} else {
+		scramble<N, T, uint16_t>
+			(in, phase_plane.get(), [](std::complex<double> c)
+			{ return static_cast<uint16_t>(complex_to_hue(c) * max_hue_code + 0.5); });
+	}
+}
+
+template<ColorMode MODE>
+static void fill_intensity_table(std::vector<float> &table, double factor1, double factor2)
+{
+	for (size_t code = 0; code < table.size(); ++code)
+		table[code] = static_cast<float>(apply_color_mode<MODE>(decode_magnitude(code), factor1, factor2));
+}
+
+void OperatorView::update_intensity_table()
+{
+	if (intensity_table_valid && intensity_table_mode == state.mode && intensity_table_scale == state.scale)
+		return;
+
+	// Magnitudes are relative to the maximum
+	auto [factor1, factor2] = get_color_factors(state.mode, 1.0, state.scale);
+	switch (state.mode) {
+	case ColorMode::LINEAR:
+	default:
+		fill_intensity_table<ColorMode::LINEAR>(intensity_table, factor1, factor2);
+		break;
+	case ColorMode::ROOT:
+		fill_intensity_table<ColorMode::ROOT>(intensity_table, factor1, factor2);
+		break;
+	case ColorMode::LOG:
+		fill_intensity_table<ColorMode::LOG>(intensity_table, factor1, factor2);
+		break;
+	}
+	intensity_table_valid = true;
+	intensity_table_mode = state.mode;
+	intensity_table_scale = state.scale;
+}
 
-	scramble<N, T, uint32_t>
-		(in, out, [f1 = factor1, f2 = factor2, fun](T c)
-		{ return (*fun)(c, f1, f2); });
+template<typename Function>
+static void color_planes_doit(const uint16_t *magnitude, const uint16_t *phase, const float *table,
+			      uint32_t *out, size_t size, Function fun)
+{
+	magnitude = assume_aligned(magnitude);
+	phase = assume_aligned(phase);
+	out = assume_aligned(out);
+	for (size_t i = 0; i < size; ++i)
+		out[i] = fun(phase[i], table[magnitude[i]]);
+}
+
+void OperatorView::color_planes()
+{
+	update_intensity_table();
+
+	size_t n = get_fft_size();
+	auto doit = [this, n](auto fun) {
+		color_planes_doit(magnitude_plane.get(), phase_plane.get(), intensity_table.data(),
+				  imagebuf.get(), n * n, fun);
+	};
+	if (planes_complex) {
+		switch (state.color_type) {
+		case ColorType::RW:
+		default:
+			doit([](uint16_t h, double v) { return hue_intensity_to_rgb<ColorType::RW>(h * hue_code_factor, v); });
+			break;
+		case ColorType::HSV:
+			doit([](uint16_t h, double v) { return hue_intensity_to_rgb<ColorType::HSV>(h * hue_code_factor, v); });
+			break;
+		case ColorType::HSV_WHITE:
+			doit([](uint16_t h, double v) { return hue_intensity_to_rgb<ColorType::HSV_WHITE>(h * hue_code_factor, v); });
+			break;
+		}
+	} else {
+		switch (state.color_type) {
+		case ColorType::RW:
+		default:
+			doit([](uint16_t sign, double v) { return signed_intensity_to_rgb<ColorType::RW>(sign != 0, v); });
+			break;
+		case ColorType::HSV:
+			doit([](uint16_t sign, double v) { return signed_intensity_to_rgb<ColorType::HSV>(sign != 0, v); });
+			break;
+		case ColorType::HSV_WHITE:
+			doit([](uint16_t sign, double v) { return signed_intensity_to_rgb<ColorType::HSV_WHITE>(sign != 0, v); });
+			break;
+		}
+	}
 }
 
 template<size_t N>
@@ -121,21 +242,180 @@ void OperatorView::calculate()
 		return;
 	}
 
+	if (!planes_valid) {
+		planes_complex = input_connectors[0]->get_buffer().is_complex();
+		if (planes_complex)
+			calculate_planes<N, std::complex<double>>();
+		else
+			calculate_planes<N, double>();
+		planes_valid = true;
+	}
+	color_planes();
+
+	show_image(QImage(reinterpret_cast<const unsigned char *>(imagebuf.get()),
+			  N, N, QImage::Format_RGB32));
+}
+
+size_t OperatorView::get_lod_level() const
+{
+	size_t n = get_fft_size();
+	double zoom = get_zoom();
+	size_t level = 0;
+	while ((n >> (level + 1)) >= min_lod_size && zoom * (1 << (level + 1)) <= 1.0)
+		++level;
+	return level;
+}
+
+template<typename T>
+void OperatorView::build_lod_levels(size_t level)
+{
+	FFTBuf &buf = input_connectors[0]->get_buffer();
+	size_t n = get_fft_size();
+	if (lod_levels.size() < level)
+		lod_levels.resize(level);
+
+	auto norm = [](const auto &v) { return std::norm(v); };
+	for (size_t l = lod_num_levels; l < level; ++l) {
+		size_t m = n >> (l + 1);
+		std::vector<std::complex<double>> &out = lod_levels[l];
+		out.resize(m * m);
+		if (l == 0) {
+			// Read from the buffer: the display shows the quadrants swapped.
+			const T *in = buf.get_data<T>();
+			size_t mask = n - 1;
+			for (size_t y = 0; y < m; ++y) {
+				for (size_t x = 0; x < m; ++x) {
+					T best = T();
+					for (size_t dy = 0; dy < 2; ++dy) {
+						const T *line = in + ((2 * y + dy + n / 2) & mask) * n;
+						for (size_t dx = 0; dx < 2; ++dx) {
+							T v = line[(2 * x + dx + n / 2) & mask];
+							if (norm(v) > norm(best))
+								best = v;
+						}
+					}
+					out[y * m + x] = best;
+				}
+			}
+		} else {
+			const std::vector<std::complex<double>> &in = lod_levels[l - 1];
+			for (size_t y = 0; y < m; ++y) {
+				for (size_t x = 0; x < m; ++x) {
+					std::complex<double> best;
+					for (size_t dy = 0; dy < 2; ++dy) {
+						const std::complex<double> *line = &in[(2 * y + dy) * 2 * m];
+						for (size_t dx = 0; dx < 2; ++dx) {
+							std::complex<double> v = line[2 * x + dx];
+							if (norm(v) > norm(best))
+								best = v;
+						}
+					}
+					out[y * m + x] = best;
+				}
+			}
+		}
+	}
+	lod_num_levels = std::max(lod_num_levels, level);
+}
+
+template<typename T>
+void OperatorView::color_level(size_t level, uint32_t *out) const
+{
 	FFTBuf &buf = input_connectors[0]->get_buffer();
+	double max = sqrt(buf.get_max_norm());
+	auto [factor1, factor2] = get_color_factors(state.mode, max, state.scale);
+	uint32_t (*fun)(T, double, double) = get_color_lookup_function<T>(state.color_type, state.mode);
 
-	if (buf.is_complex())
-		calculate_doit<N, std::complex<double>>();
-	else
-		calculate_doit<N, double>();
+	size_t n = get_fft_size();
+	if (level == 0) {
+		// Full resolution outside of the templated fast path (used for saving)
+		const T *in = buf.get_data<T>();
+		size_t mask = n - 1;
+		for (size_t y = 0; y < n; ++y) {
+			const T *line = in + ((y + n / 2) & mask) * n;
+			for (size_t x = 0; x < n; ++x)
+				*out++ = (*fun)(line[(x + n / 2) & mask], factor1, factor2);
+		}
+		return;
+	}
+
+	for (const std::complex<double> &c: lod_levels[level - 1]) {
+		if constexpr (std::is_same_v<T, double>)
+			*out++ = (*fun)(c.real(), factor1, factor2);
+		else
+			*out++ = (*fun)(c, factor1, factor2);
+	}
+}
+
+void OperatorView::show_level(size_t level)
+{
+	lod_level = level;
+	if (level == 0) {
+		dispatch_calculate(*this);
+		return;
+	}
+	if (input_connectors[0]->is_empty_buffer()) {
+		show_empty();
+		return;
+	}
+
+	if (input_connectors[0]->get_buffer().is_complex()) {
+		build_lod_levels<std::complex<double>>(level);
+		color_level<std::complex<double>>(level, imagebuf.get());
+	} else {
+		build_lod_levels<double>(level);
+		color_level<double>(level, imagebuf.get());
+	}
 
-	QImage image(reinterpret_cast<unsigned char *>(imagebuf.get()),
-		     N, N, QImage::Format_RGB32);
-	setPixmap(QPixmap::fromImage(image));
+	size_t n = get_fft_size();
+	size_t m = n >> level;
+	show_image(QImage(reinterpret_cast<const unsigned char *>(imagebuf.get()),
+			  m, m, QImage::Format_RGB32), QRect(), QSize(n, n));
 }
 
 void OperatorView::execute()
 {
-	dispatch_calculate(*this);
+	// The input changed: the planes and levels of detail must be recalculated
+	planes_valid = false;
+	lod_num_levels = 0;
+	show_level(get_lod_level());
+}
+
+bool OperatorView::has_demand() const
+{
+	return is_on_screen();
+}
+
+void OperatorView::level_of_detail_changed()
+{
+	size_t level = get_lod_level();
+	if (level != lod_level)
+		show_level(level);
+}
+
+QImage OperatorView::get_result_image() const
+{
+	// The displayed image is a wrapper of the image buffer, which will be overwritten
+	if (lod_level == 0)
+		return get_display_image().copy();
+
+	// Zoomed out: color the full resolution image
+	if (input_connectors[0]->is_empty_buffer())
+		return QImage();
+	size_t n = get_fft_size();
+	QImage res(n, n, QImage::Format_RGB32);
+	uint32_t *out = reinterpret_cast<uint32_t *>(res.bits());
+	if (input_connectors[0]->get_buffer().is_complex())
+		color_level<std::complex<double>>(0, out);
+	else
+		color_level<double>(0, out);
+	return res;
+}
+
+void OperatorView::set_result_image(const QImage &image)
+{
+	if (image.width() == pixmap().width() && image.height() == pixmap().height())
+		setPixmap(QPixmap::fromImage(image));
 }
 
 static double round_to_digits(double v, int digits)
@@ -213,7 +493,10 @@ void OperatorView::save_file()
 	if (filename.isEmpty())
 		return;
 
-	if (!pixmap().save(filename, "PNG"))
+	QImage image = get_result_image();
+	if (image.isNull())
+		image = pixmap().toImage();
+	if (!image.save(filename, "PNG"))
 		QMessageBox::warning(nullptr, "Error", "Couldn't save image");
 
 	Globals::set_last_save_image(filename);
@@ -8,6 +8,9 @@
 
 #include <QImage>
 
+#include <complex>
+#include <vector>
+
 class OperatorViewState final : public Operator::StateTemplate<OperatorViewState> {
 	QJsonObject to_json() const override;
 	void from_json(const QJsonObject &) override;
@@ -49,12 +52,45 @@ class OperatorView : public OperatorTemplate<OperatorId::View, OperatorViewState
 
 	bool dont_accumulate_undo;
 
-	template<size_t N, typename T> void calculate_doit();
+	// Quantized planes of the input in display order. They are only recalculated
+	// when the input changes. Changes of scale, color mode and color type only need
+	// table lookups. The magnitude is log encoded relative to the maximum.
+	// The phase plane contains the hue for complex input and the sign for real input.
+	AlignedBuf<uint16_t> magnitude_plane;
+	AlignedBuf<uint16_t> phase_plane;
+	bool planes_valid;
+	bool planes_complex;
+	template<size_t N, typename T> void calculate_planes();
+	void color_planes();
+
+	// Intensity of every magnitude code. Depends on color mode and scale.
+	std::vector<float> intensity_table;
+	bool intensity_table_valid;
+	ColorMode intensity_table_mode;
+	double intensity_table_scale;
+	void update_intensity_table();
+
+	// Level of detail: if the view is zoomed out, a reduced image is colored.
+	// A pixel of level l+1 is the pixel of largest magnitude of a 2x2 block of
+	// level l, so that sharp peaks don't vanish. The levels are stored in display
+	// order, lod_levels[l-1] is level l. They are calculated on demand.
+	static constexpr size_t min_lod_size = 32;
+	std::vector<std::vector<std::complex<double>>> lod_levels;
+	size_t lod_num_levels;	// Number of valid levels
+	size_t lod_level;	// Currently shown level
+	size_t get_lod_level() const;
+	void show_level(size_t level);
+	template<typename T> void build_lod_levels(size_t level);
+	template<typename T> void color_level(size_t level, uint32_t *out) const;
+	void level_of_detail_changed() override;
+	bool has_demand() const override;	// Only calculate if on screen
 public:
 	inline static constexpr const char *icon = ":/icons/view.svg";
 	inline static constexpr const char *tooltip = "Add View";
 
 	using OperatorTemplate::OperatorTemplate;
+	QImage get_result_image() const override;
+	void set_result_image(const QImage &) override;
 private:
 	friend class Operator;
 	template<size_t N> void calculate();
@@ -267,9 +267,8 @@ void OperatorWave::calculate()
 		output_buffers[0].set_extremes(Extremes(max_norm));
 	}
 
-	QImage image(reinterpret_cast<unsigned char *>(imagebuf.get()),
-		     N, N, QImage::Format_RGB32);
-	setPixmap(QPixmap::fromImage(image));
+	show_image(QImage(reinterpret_cast<const unsigned char *>(imagebuf.get()),
+			  N, N, QImage::Format_RGB32));
 }
 
 void OperatorWave::paint_wave()
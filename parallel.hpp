@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0
+// Simple helper to distribute independent work items over all cores.
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+// Calls fun(i) for i in [0, n). The items are split into contiguous
+// ranges, one per thread. The calling thread processes the first range.
+// Returns after all items were processed.
+template <typename Function>
+void parallel_for(size_t n, Function fun)
+{
+	size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+	num_threads = std::min(num_threads, n);
+	if (num_threads <= 1) {
+		for (size_t i = 0; i < n; ++i)
+			fun(i);
+		return;
+	}
+
+	auto do_range = [&fun](size_t from, size_t to) {
+		for (size_t i = from; i < to; ++i)
+			fun(i);
+	};
+
+	std::vector<std::future<void>> futures;
+	futures.reserve(num_threads - 1);
+	for (size_t t = 1; t < num_threads; ++t)
+		futures.push_back(std::async(std::launch::async, do_range,
+					     n * t / num_threads, n * (t + 1) / num_threads));
+	do_range(0, n / num_threads);
+	for (std::future<void> &f: futures)
+		f.get();
+}
+
+#endif
@@ -9,9 +9,12 @@
 #include "operator.hpp"
 
 #include <QGraphicsSceneHoverEvent>
+#include <QGraphicsSceneWheelEvent>
 #include <QScrollBar>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 
 Scene::Scene(MainWindow &w_, QObject *parent)
 	: QGraphicsScene(parent)
@@ -21,7 +24,35 @@ Scene::Scene(MainWindow &w_, QObject *parent)
 	, magnifier(nullptr)
 	, handle_drag(nullptr)
 	, operator_move(nullptr)
+	, move_pending(false)
+	, drag_pending(false)
+	, idle_pending(false)
 {
+	move_timer.setSingleShot(true);
+	move_timer.setInterval(move_interval);
+	connect(&move_timer, &QTimer::timeout, [this]() {
+		if (move_pending && operator_move)
+			reroute_moved_edges();
+	});
+
+	drag_timer.setSingleShot(true);
+	drag_timer.setInterval(drag_interval);
+	connect(&drag_timer, &QTimer::timeout, [this]() {
+		if (drag_pending && handle_drag)
+			execute_drag();
+	});
+
+	// Scrolling generates many events. Only calculate once it has settled.
+	demand_timer.setSingleShot(true);
+	demand_timer.setInterval(demand_interval);
+	connect(&demand_timer, &QTimer::timeout, [this]() {
+		w.get_document().topo.execute_dirty();
+		resume_idle();
+	});
+
+	idle_timer.setSingleShot(true);
+	idle_timer.setInterval(0);
+	connect(&idle_timer, &QTimer::timeout, [this]() { execute_idle(); });
 }
 
 Scene::~Scene()
@@ -32,6 +63,8 @@ Scene::~Scene()
 void Scene::clear()
 {
 	enter_normal_mode();
+	idle_timer.stop();
+	idle_pending = false;
 	selection.clear();
 	emit selection_changed(selection.is_empty());
 }
@@ -48,8 +81,10 @@ void Scene::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
 		QGraphicsScene::mouseMoveEvent(event);
 	} else if (handle_drag) {
 		handle_drag->drag(event->scenePos(), event->modifiers());
+		execute_drag();
 	} else if (operator_move) {
-		operator_move->move_event(event->scenePos());
+		if (operator_move->move_event(event->scenePos()))
+			reroute_moved_edges();
 	} else if (magnifier) {
 		magnifier->go(this, event->scenePos());
 	} else {
@@ -57,6 +92,17 @@ void Scene::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
 	}
 }
 
+void Scene::wheelEvent(QGraphicsSceneWheelEvent *event)
+{
+	if (!(event->modifiers() & Qt::ControlModifier)) {
+		QGraphicsScene::wheelEvent(event);
+		return;
+	}
+	// One notch (120 units) zooms by a factor of sqrt(2)
+	zoom(pow(2.0, event->delta() / 240.0));
+	event->accept();
+}
+
 void Scene::connector_clicked(Connector *conn)
 {
 	if (mode != Mode::normal)
@@ -82,6 +128,31 @@ void Scene::enter_drag_mode(HandleInterface *handle)
 	mode = Mode::drag;
 	handle_drag = handle;
 	set_cursor(Qt::ClosedHandCursor);
+
+	// Changes are only marked dirty and executed by execute_drag()
+	w.get_document().topo.set_deferred(true);
+	drag_pending = false;
+}
+
+void Scene::execute_drag()
+{
+	if (drag_timer.isActive()) {
+		drag_pending = true;
+		return;
+	}
+	drag_pending = false;
+	w.get_document().topo.execute_dirty();
+	drag_timer.start();
+}
+
+// Execute the last state
+void Scene::finish_drag()
+{
+	drag_timer.stop();
+	drag_pending = false;
+	TopologicalOrder &topo = w.get_document().topo;
+	topo.set_deferred(false);
+	topo.execute_dirty();
 }
 
 void Scene::enter_move_mode(Operator *op)
@@ -97,6 +168,17 @@ void Scene::enter_move_mode(Operator *op)
 	set_cursor(Qt::ClosedHandCursor);
 }
 
+void Scene::reroute_moved_edges()
+{
+	if (move_timer.isActive()) {
+		move_pending = true;
+		return;
+	}
+	move_pending = false;
+	operator_move->reroute_moved_edges();
+	move_timer.start();
+}
+
 void Scene::selectable_clicked(Selectable *s, QGraphicsSceneMouseEvent *event)
 {
 	if (mode != Mode::normal && mode != Mode::drag)
@@ -201,6 +283,7 @@ void Scene::enter_normal_mode()
 	exit_mode();
 	mode = Mode::normal;
 	set_cursor(Qt::ArrowCursor);
+	resume_idle();
 }
 
 void Scene::enter_add_object_mode(std::unique_ptr<Operator> &&op)
@@ -247,8 +330,13 @@ void Scene::exit_mode()
 			handle_drag->leave_drag_mode(false);
 			handle_drag = nullptr;
 		}
+		finish_drag();
 		break;
 	case Mode::move:
+		// Leaving move mode routes all edges anyway
+		move_timer.stop();
+		move_pending = false;
+
 		// operator_move was set to nullptr if the value was commited
 		if (operator_move) {
 			operator_move->leave_move_mode(false);
@@ -284,6 +372,65 @@ void Scene::set_cursor(Qt::CursorShape shape)
 	get_view()->viewport()->setCursor(shape);
 }
 
+double Scene::get_zoom() const
+{
+	return views().empty() ? 1.0 : get_view()->transform().m11();
+}
+
+void Scene::set_zoom(double zoom)
+{
+	zoom = std::clamp(zoom, min_zoom, max_zoom);
+	if (views().empty() || zoom == get_zoom())
+		return;
+	get_view()->setTransform(QTransform::fromScale(zoom, zoom));
+	for (Operator *op: w.get_document().topo.get_operators())
+		op->level_of_detail_changed();
+	update_demand();
+}
+
+bool Scene::is_on_screen(const QRectF &rect) const
+{
+	if (views().empty() || !w.isVisible() || w.isMinimized())
+		return false;
+	const QGraphicsView *view = get_view();
+	QRectF visible = view->mapToScene(view->viewport()->rect()).boundingRect();
+	return visible.intersects(rect);
+}
+
+void Scene::update_demand()
+{
+	demand_timer.start();
+}
+
+void Scene::calculate_in_idle_time()
+{
+	idle_pending = true;
+	resume_idle();
+}
+
+void Scene::resume_idle()
+{
+	if (idle_pending && !idle_timer.isActive())
+		idle_timer.start();
+}
+
+void Scene::execute_idle()
+{
+	// Visible operators and interaction go first. The timer is not re-armed:
+	// the demand timer and leaving the drag or move mode resume the calculation.
+	if (demand_timer.isActive() || handle_drag || operator_move)
+		return;
+	if (w.get_document().topo.execute_next_dirty())
+		idle_timer.start();
+	else
+		idle_pending = false;
+}
+
+void Scene::zoom(double factor)
+{
+	set_zoom(get_zoom() * factor);
+}
+
 QPoint Scene::get_scroll_position() const
 {
 	const QGraphicsView *view = get_view();
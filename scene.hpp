@@ -9,6 +9,7 @@
 #include <QGraphicsScene>
 #include <QGraphicsItem>
 #include <QGraphicsView>
+#include <QTimer>
 
 #include <memory>
 
@@ -49,6 +50,34 @@ private:
 	// Defined if we are in move mode
 	Operator *operator_move;
 
+	// Edges of a moved operator are rerouted at most once per move_interval.
+	// Move events in between are coalesced and handled when the timer expires.
+	static constexpr int move_interval = 16;	// ms
+	QTimer move_timer;
+	bool move_pending;
+	void reroute_moved_edges();
+
+	// While dragging a handle, the graph is executed at most once per drag_interval.
+	// Drag events in between are coalesced.
+	static constexpr int drag_interval = 16;	// ms
+	QTimer drag_timer;
+	bool drag_pending;
+	void execute_drag();
+	void finish_drag();
+
+	// Operators that became visible are calculated at most once per demand_interval
+	static constexpr int demand_interval = 50;	// ms
+	QTimer demand_timer;
+
+	// Dirty operators without demand are calculated one per idle_timer tick,
+	// after the visible operators. Used after loading a document with
+	// embedded results: the restored images are replaced as the results arrive.
+	// The timer is single-shot and re-armed after every calculated operator.
+	QTimer idle_timer;
+	bool idle_pending;
+	void execute_idle();
+	void resume_idle();
+
 	// Mode changes
 	void exit_mode();
 
@@ -59,6 +88,7 @@ private:
 	void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
 	void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
 	void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
+	void wheelEvent(QGraphicsSceneWheelEvent *event) override;	// Ctrl+wheel zooms
 signals:
 	void selection_changed(bool empty_selection);
 public:
@@ -74,6 +104,21 @@ public:
 	void set_scroll_position(const QPoint &) const;
 	void set_cursor(Qt::CursorShape shape);
 
+	// Demand driven evaluation: operators outside of the visible area are not calculated.
+	// is_on_screen() returns false if the window is hidden or minimized.
+	// Call update_demand() when the visible area changes.
+	bool is_on_screen(const QRectF &rect) const;
+	void update_demand();
+	void calculate_in_idle_time();
+
+	// Zoom of the view. On change, operators are informed, so that they can
+	// adapt their level of detail.
+	static constexpr double min_zoom = 1.0 / 16.0;
+	static constexpr double max_zoom = 4.0;
+	double get_zoom() const;
+	void set_zoom(double zoom);
+	void zoom(double factor);
+
 	// Mode changes
 	void enter_add_object_mode(std::unique_ptr<Operator> &&);
 	void enter_magnifier_mode();
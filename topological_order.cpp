@@ -3,7 +3,9 @@
 #include "edge.hpp"
 #include "operator.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <optional>
 
 void TopologicalOrder::add_operator(Operator *o)
 {
@@ -236,8 +238,27 @@ static void mark_children(const Operator *op, std::vector<int> &update, size_t i
 	}
 }
 
+// Mark only the children that look through this operator to find a shortcut.
+static void mark_shortcut_children(const Operator *op, std::vector<int> &update, size_t id_from, size_t id_to, size_t act_id)
+{
+	size_t num_output = op->num_output();
+	for (size_t i = 0; i < num_output; ++i) {
+		const Connector &conn = op->get_output_connector(i);
+		for (const Connector *child: conn.get_children()) {
+			if (!child->op()->shortcut_depends_on(*op))
+				continue;
+			size_t id = child->op()->get_topo_id();
+			assert(id > act_id && id < id_to);
+			update[id - id_from] = 1;
+		}
+	}
+}
+
 void TopologicalOrder::update_buffers(Operator *op, bool update_first) const
 {
+	if (suspended)
+		return;
+
 	size_t id_from = op->get_topo_id();
 	size_t id_to = ops.size();
 	size_t range_size = id_to - id_from;
@@ -249,16 +270,27 @@ void TopologicalOrder::update_buffers(Operator *op, bool update_first) const
 		if (!update[act_id - id_from])
 			continue;
 		Operator *op = ops[act_id];
-		if (update_first || act_id !=id_from)
-			if (!op->input_connection_changed())
+		if (update_first || act_id !=id_from) {
+			if (!op->input_connection_changed()) {
+				// The output is unchanged, but the input might be.
+				// Reevaluate shortcuts of children that depend on it.
+				mark_shortcut_children(op, update, id_from, id_to, act_id);
 				continue;
+			}
+		}
 
 		mark_children(op, update, id_from, id_to, act_id);
 	}
 }
 
+// Evaluation is demand driven: execute() only marks the operator and its children
+// as dirty. Then, the dirty operators that are needed by an operator with demand
+// are executed (pull). The others stay dirty until they are needed.
 void TopologicalOrder::execute(Operator *op, bool update_first) const
 {
+	if (suspended)
+		return;
+
 	size_t id_from = op->get_topo_id();
 	size_t id_to = ops.size();
 	size_t range_size = id_to - id_from;
@@ -270,11 +302,132 @@ void TopologicalOrder::execute(Operator *op, bool update_first) const
 		if (!update[act_id - id_from])
 			continue;
 		Operator *op = ops[act_id];
-		if (update_first || act_id !=id_from)
-			op->execute();
+		// Without update_first, the operator has already updated its data
+		op->set_dirty(update_first || act_id != id_from);
 
 		mark_children(op, update, id_from, id_to, act_id);
 	}
+	if (!deferred)
+		execute_dirty();
+}
+
+static bool has_forwarded_output(const Operator *op)
+{
+	for (size_t i = 0; i < op->num_output(); ++i) {
+		if (op->get_output_connector(i).get_buffer().is_forwarded())
+			return true;
+	}
+	return false;
+}
+
+// The results of an operator of a pointwise chain don't have to be stored if it
+// has no demand and is only read by later operators of the chain. These operators
+// stay dirty, so that they are executed again when another child needs them.
+// Operators that forward their input (shortcuts) expose it, if they store their output.
+void TopologicalOrder::execute_chain(const std::vector<Operator *> &chain, const std::vector<int> &run,
+				     bool only_demanded) const
+{
+	std::vector<bool> store(chain.size(), true);
+	if (only_demanded && chain.size() > 1) {
+		auto chain_pos = [&chain](size_t id) -> std::optional<size_t> {
+			auto it = std::lower_bound(chain.begin(), chain.end(), id,
+						   [](const Operator *op, size_t id) { return op->get_topo_id() < id; });
+			if (it == chain.end() || (*it)->get_topo_id() != id)
+				return {};
+			return it - chain.begin();
+		};
+		for (size_t pos = chain.size(); pos-- > 0; ) {
+			const Operator *op = chain[pos];
+			bool s = op->has_demand() || has_forwarded_output(op);
+			for (size_t i = 0; i < op->num_output() && !s; ++i) {
+				for (const Edge *child: op->get_output_connector(i).get_children_edges()) {
+					const Operator *child_op = child->get_connector_to()->op();
+					size_t id = child_op->get_topo_id();
+					if (!run[id])
+						continue;
+					std::optional<size_t> child_pos = chain_pos(id);
+					if (!child_pos || (store[*child_pos] && has_forwarded_output(child_op))) {
+						s = true;
+						break;
+					}
+				}
+			}
+			store[pos] = s;
+		}
+	}
+
+	Operator::execute_pointwise_chain(chain, store);
+	for (size_t pos = 0; pos < chain.size(); ++pos) {
+		if (!store[pos])
+			chain[pos]->set_dirty(true);
+	}
+}
+
+// An operator is executed if it is dirty and if it has demand or one of its
+// children is executed. Since the operators are sorted topologically, this is
+// decided in one backward pass. Usually, the children of a dirty operator are
+// dirty as well. The exception are unstored results of pointwise chains, see
+// execute_chain(): they are only recalculated when a child needs them.
+// Runs of pointwise operators are collected and executed tile-by-tile.
+// Since the operators are sorted topologically, all inputs of a run
+// are calculated before the run.
+void TopologicalOrder::execute_dirty(bool only_demanded) const
+{
+	if (suspended)
+		return;
+	if (std::none_of(ops.begin(), ops.end(), [](const Operator *op) { return op->is_dirty(); }))
+		return;
+
+	size_t size = ops.size();
+	std::vector<int> run(size, 0);
+	for (size_t act_id = size; act_id-- > 0; ) {
+		const Operator *op = ops[act_id];
+		if (!op->is_dirty())
+			continue;
+		if (!only_demanded || op->has_demand()) {
+			run[act_id] = 1;
+			continue;
+		}
+		size_t num_output = op->num_output();
+		for (size_t i = 0; i < num_output && !run[act_id]; ++i) {
+			for (const Edge *child: op->get_output_connector(i).get_children_edges()) {
+				size_t id = child->get_connector_to()->op()->get_topo_id();
+				assert(id > act_id);
+				if (run[id]) {
+					run[act_id] = 1;
+					break;
+				}
+			}
+		}
+	}
+
+	std::vector<Operator *> chain;
+	for (size_t act_id = 0; act_id < size; ++act_id) {
+		Operator *op = ops[act_id];
+		if (!run[act_id])
+			continue;
+		op->set_dirty(false);
+		if (op->is_pointwise()) {
+			chain.push_back(op);
+		} else {
+			execute_chain(chain, run, only_demanded);
+			chain.clear();
+			op->execute();
+		}
+	}
+	execute_chain(chain, run, only_demanded);
+}
+
+bool TopologicalOrder::execute_next_dirty() const
+{
+	if (suspended)
+		return false;
+	auto it = std::find_if(ops.begin(), ops.end(), [](const Operator *op) { return op->is_dirty(); });
+	if (it == ops.end())
+		return false;
+	(*it)->set_dirty(false);
+	(*it)->execute();
+	return true;
 }
 
 void TopologicalOrder::for_all_children(void (*func)(Operator *))
@@ -298,7 +451,23 @@ void TopologicalOrder::update_all_buffers()
 
 void TopologicalOrder::execute_all()
 {
-	for_all_children([](Operator *op) { op->execute(); });
+	mark_all_dirty();
+	execute_dirty();
+}
+
+void TopologicalOrder::mark_all_dirty()
+{
+	for_all_children([](Operator *op) { op->set_dirty(true); });
+}
+
+void TopologicalOrder::set_suspended(bool suspended_)
+{
+	suspended = suspended_;
+}
+
+void TopologicalOrder::set_deferred(bool deferred_)
+{
+	deferred = deferred_;
 }
 
 void TopologicalOrder::clear()
@@ -14,11 +14,15 @@ class Edge;
 
 class TopologicalOrder {
 	std::vector<Operator *> ops;
+	bool suspended = false;
+	bool deferred = false;
 
 	std::vector<int> get_end_reachable_from(size_t begin, size_t end, size_t &num);
 	std::vector<int> get_reachable_from_begin(size_t begin, size_t end, size_t &num);
 
 	void for_all_children(void (*func)(Operator *));
+	void execute_chain(const std::vector<Operator *> &chain, const std::vector<int> &run,
+			   bool only_demanded) const;
 public:
 	// Add/remove edges and operators. There is no need for
 	// a remove_edge() call, because topological order stays
@@ -39,8 +43,21 @@ public:
 
 	// Execute operator and children
 	// If the second argument is false, the input operator will not be executed
+	// The operators are only marked as dirty, and only those needed by an
+	// operator with demand (see Operator::has_demand()) are executed.
 	void execute(Operator *op, bool update_first) const;
 
+	// Execute dirty operators in the input cone of operators with demand.
+	// Called when the demand changes, e.g. when a view is scrolled into the visible area.
+	// If only_demanded is false, all dirty operators are executed.
+	void execute_dirty(bool only_demanded = true) const;
+
+	// Execute the first dirty operator in topological order. Its inputs are
+	// up to date, since all of its ancestors come before it.
+	// Used to calculate operators without demand in idle time.
+	// Returns false if there was nothing to do.
+	bool execute_next_dirty() const;
+
 	// Delete all entries
 	void clear();
 
@@ -52,8 +69,18 @@ public:
 	Operator *get_by_id(size_t id);
 
 	// After loading: update all buffers and execute all children
+	// mark_all_dirty() only marks them, they are calculated when needed.
 	void update_all_buffers();
 	void execute_all();
+	void mark_all_dirty();
+
+	// While suspended, update_buffers() and execute() do nothing.
+	// Used for loading, when everything is recalculated afterwards anyway.
+	void set_suspended(bool suspended);
+
+	// While deferred, execute() only marks operators as dirty and the
+	// caller runs execute_dirty(). Used to coalesce changes while dragging.
+	void set_deferred(bool deferred);
 };
 
 #endif
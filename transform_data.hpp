@@ -3,6 +3,8 @@
 // on one or more data blocks and put the result in a third data block.
 // It is assumed that the data is aligned according to AlignedBuf.
 // A convenience wrapper operates directly on FFTBuf objects.
+// The range version only processes the elements from begin to end,
+// which is used to execute chains of operators tile-by-tile.
 
 #ifndef TRANSFORM_DATA_HPP
 #define TRANSFORM_DATA_HPP
@@ -15,6 +17,9 @@ void transform_data(size_t n, FFTBuf &in1, FFTBuf &in2, FFTBuf &out, FUNC fn);
 template <typename T1, typename T2, typename T3, typename FUNC>
 void transform_data(size_t n, const T1 *in1, const T2 *in2, T3 *out, FUNC fn);
 
+template <typename T1, typename T2, typename T3, typename FUNC>
+void transform_data_range(size_t begin, size_t end, FFTBuf &in1, FFTBuf &in2, FFTBuf &out, FUNC fn);
+
 #include "transform_data_impl.hpp"
 
 #endif
@@ -12,3 +12,13 @@ void transform_data(size_t n, FFTBuf &in1, FFTBuf &in2, FFTBuf &out, FUNC fn)
 {
 	transform_data<T1, T2, T3>(n, in1.get_data<T1>(), in2.get_data<T2>(), out.get_data<T3>(), fn);
 }
+
+template <typename T1, typename T2, typename T3, typename FUNC>
+void transform_data_range(size_t begin, size_t end, FFTBuf &in1, FFTBuf &in2, FFTBuf &out, FUNC fn)
+{
+	const T1 *in1_data = in1.get_range_data<T1>(begin);
+	const T2 *in2_data = in2.get_range_data<T2>(begin);
+	T3 *out_data = out.get_range_data<T3>(begin);
+	for (size_t i = begin; i < end; ++i)
+		*out_data++ = fn(*in1_data++, *in2_data++);
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "undo_store.hpp"
+
+#include <cassert>
+
+qint64 UndoStore::write(const QByteArray &data)
+{
+	if (file_failed)
+		return -1;
+	if (!file.isOpen() && !file.open()) {
+		file_failed = true;
+		return -1;
+	}
+	qint64 offset = file.size();
+	if (!file.seek(offset) || file.write(data) != data.size() || !file.flush())
+		return -1;
+	return offset;
+}
+
+QByteArray UndoStore::read(qint64 offset, qint64 size)
+{
+	assert(file.isOpen());
+	if (!file.seek(offset))
+		return QByteArray();
+	return file.read(size);
+}
+
+qint64 UndoStore::file_size() const
+{
+	return file.isOpen() ? file.size() : 0;
+}
+
+PackedData::PackedData(QByteArray raw)
+	: offset(-1)
+	, size(0)
+	, raw_size(raw.size())
+{
+	// The lambda clears its copy of the data, so that the memory
+	// is freed as soon as compression is finished.
+	future = std::async(std::launch::async, [raw = std::move(raw)]() mutable {
+		QByteArray res = qCompress(raw, 1);
+		raw.clear();
+		return res;
+	});
+}
+
+void PackedData::wait()
+{
+	if (!future.valid())
+		return;
+	data = future.get();
+	size = data.size();
+}
+
+void PackedData::poll()
+{
+	if (future.valid() &&
+	    future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		wait();
+}
+
+void PackedData::spill(UndoStore &store)
+{
+	poll();
+	if (future.valid() || offset >= 0)
+		return;
+	qint64 new_offset = store.write(data);
+	if (new_offset < 0)
+		return;
+	offset = new_offset;
+	data = QByteArray();
+}
+
+std::optional<QByteArray> PackedData::unpack(UndoStore &store)
+{
+	wait();
+	QByteArray compressed = offset >= 0 ? store.read(offset, size) : data;
+	if (compressed.size() != size)
+		return {};
+	QByteArray res = qUncompress(compressed);
+	if (static_cast<size_t>(res.size()) != raw_size)
+		return {};
+	return res;
+}
+
+bool PackedData::is_compressing() const
+{
+	return future.valid();
+}
+
+bool PackedData::is_spilled() const
+{
+	return offset >= 0;
+}
+
+size_t PackedData::memory_usage() const
+{
+	if (future.valid())
+		return raw_size;
+	return data.size();
+}
+
+size_t PackedData::disk_usage() const
+{
+	return offset >= 0 ? size : 0;
+}
+
+size_t PackedData::get_raw_size() const
+{
+	return raw_size;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0
+// Storage for the heavy data (images, buffers) of old undo commands.
+// Data is packed in two steps:
+//	1) compressed in a background thread.
+//	2) spilled to a temporary file, which is shared by all commands of a document.
+// On undo or redo the data is read back and uncompressed.
+
+#ifndef UNDO_STORE_HPP
+#define UNDO_STORE_HPP
+
+#include <QByteArray>
+#include <QTemporaryFile>
+
+#include <future>
+#include <optional>
+
+class UndoStore {
+	QTemporaryFile file;
+	bool file_failed = false;
+public:
+	// Returns the offset in the file or -1 on failure.
+	// Space in the file is never reused. It is freed when the document is closed.
+	qint64 write(const QByteArray &data);
+	QByteArray read(qint64 offset, qint64 size);
+	qint64 file_size() const;
+};
+
+class PackedData {
+	std::future<QByteArray> future;	// Valid until the compressed data was collected
+	QByteArray data;		// Compressed data, empty if spilled
+	qint64 offset;			// Offset in spill file, -1 if in memory
+	qint64 size;			// Size of compressed data
+	size_t raw_size;
+	void wait();
+public:
+	// Starts compression in the background
+	PackedData(QByteArray raw);
+
+	// Collects the compressed data if compression finished. Never blocks.
+	void poll();
+
+	// Write to disk. The compressed data is only freed once it was written
+	// and flushed. Does nothing if compression is still running or if writing
+	// fails, since keeping the compressed data in memory is still a valid fallback.
+	void spill(UndoStore &store);
+
+	// Returns the uncompressed data or no value if it couldn't be read back.
+	std::optional<QByteArray> unpack(UndoStore &store);
+
+	bool is_compressing() const;	// Compressed data not yet collected, see poll()
+	bool is_spilled() const;
+	size_t memory_usage() const;	// While compressing, the uncompressed size
+	size_t disk_usage() const;
+	size_t get_raw_size() const;
+};
+
+#endif
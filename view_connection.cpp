@@ -26,9 +26,11 @@ ViewConnection::Vertex::Vertex(const ConnectorDesc &desc_, const QPointF &pos_)
 }
 
 ViewConnection::ViewConnection(const ConnectorDesc &from, const QPointF &pos_from,
-			       const ConnectorDesc &to, const QPointF &pos_to, Scene &scene)
+			       const ConnectorDesc &to, const QPointF &pos_to,
+			       size_t id_, Scene &scene)
 	: left(from, pos_from)
 	, right(to, pos_to)
+	, id(id_)
 {
 	if (right.pos.x() < left.pos.x() || (right.pos.x() == left.pos.x() && right.pos.y() < left.pos.x()))
 		std::swap(left, right);
@@ -96,6 +98,11 @@ bool ViewConnection::cuts_rect(const QRectF &rect) const
 	return false;
 }
 
+size_t ViewConnection::get_id() const
+{
+	return id;
+}
+
 double ViewConnection::get_dist() const
 {
 	return dist;
@@ -12,6 +12,7 @@
 #include <QRect>
 
 #include <memory>
+#include <vector>
 
 class Scene;
 class Edge;
@@ -30,6 +31,9 @@ private:
 	Vertex right;
 	double dist;
 
+	// Slot in the pool of the operator list
+	size_t id;
+
 	// Remember all edges that use this connection
 	std::vector<Edge *> edges;
 
@@ -37,7 +41,9 @@ private:
 	std::unique_ptr<QGraphicsLineItem> line;
 public:
 	~ViewConnection();
-	ViewConnection(const ConnectorDesc &from, const QPointF &pos_from, const ConnectorDesc &to, const QPointF &pos_to, Scene &scene);
+	ViewConnection(const ConnectorDesc &from, const QPointF &pos_from, const ConnectorDesc &to, const QPointF &pos_to,
+		       size_t id, Scene &scene);
+	size_t get_id() const;
 	ConnectorDesc get_other(const ConnectorDesc &, QPointF &pos);
 	ConnectorDesc get_other(const ConnectorDesc &);
 
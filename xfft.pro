@@ -2,6 +2,9 @@
 QMAKE_CXX = clang++
 QMAKE_CXXFLAGS	+= -std=c++20 -g
 
+# errno is never inspected. Not setting it allows vectorization of sqrt() and friends.
+QMAKE_CXXFLAGS	+= -fno-math-errno
+
 #QMAKE_CXX = g++
 #QMAKE_CXXFLAGS	+= -pedantic -std=c++20 -g
 
@@ -42,6 +45,7 @@ HEADERS		= about.hpp \
 		  operator_pow.hpp \
 		  operator_powder.hpp \
 		  operator_inversion.hpp \
+		  operator_symmetrize.hpp \
 		  operator_pixmap.hpp \
 		  operator_polygon.hpp \
 		  operator_gauss.hpp \
@@ -50,6 +54,7 @@ HEADERS		= about.hpp \
 		  operator_view.hpp \
 		  operator_const.hpp \
 		  operator_list.hpp \
+		  operator_grid.hpp \
 		  selectable.hpp \
 		  selection.hpp \
 		  connector.hpp \
@@ -58,7 +63,10 @@ HEADERS		= about.hpp \
 		  edge_cycle.hpp \
 		  view_connection.hpp \
 		  topological_order.hpp \
+		  undo_store.hpp \
 		  document.hpp \
+		  binary_document.hpp \
+		  benchmark.hpp \
 		  globals.hpp \
 		  fft_buf.hpp \
 		  fft_plan.hpp \
@@ -66,6 +74,9 @@ HEADERS		= about.hpp \
 		  magnifier.hpp \
 		  color.hpp \
 		  extremes.hpp \
+		  image_delta.hpp \
+		  parallel.hpp \
+		  complex_math.hpp \
 		  basis_vector.hpp \
 		  svg_cache.hpp \
 		  command.hpp \
@@ -90,6 +101,7 @@ SOURCES		= about.cpp \
 		  operator_pow.cpp \
 		  operator_powder.cpp \
 		  operator_inversion.cpp \
+		  operator_symmetrize.cpp \
 		  operator_pixmap.cpp \
 		  operator_polygon.cpp \
 		  operator_gauss.cpp \
@@ -98,6 +110,7 @@ SOURCES		= about.cpp \
 		  operator_view.cpp \
 		  operator_const.cpp \
 		  operator_list.cpp \
+		  operator_grid.cpp \
 		  selectable.cpp \
 		  selection.cpp \
 		  connector.cpp \
@@ -106,7 +119,10 @@ SOURCES		= about.cpp \
 		  edge_cycle.cpp \
 		  view_connection.cpp \
 		  topological_order.cpp \
+		  undo_store.cpp \
 		  document.cpp \
+		  binary_document.cpp \
+		  benchmark.cpp \
 		  globals.cpp \
 		  fft_buf.cpp \
 		  fft_plan.cpp \
@@ -114,6 +130,8 @@ SOURCES		= about.cpp \
 		  magnifier.cpp \
 		  color.cpp \
 		  extremes.cpp \
+		  image_delta.cpp \
+		  complex_math.cpp \
 		  basis_vector.cpp \
 		  svg_cache.cpp \
 		  command.cpp \